@@ -0,0 +1,381 @@
+/**
+ * @file asset_packer/asset_packer.c
+ *
+ * Build-time tool that concatenates assets into a single pack, with an index
+ * at its start (see src/packfmt.h)
+ *
+ * Usage: asset_packer <out.pak> <name>:<format>:<path> [...]
+ *
+ * Formats:
+ *   raw - the file is stored as is
+ *   tex - a 24 or 32 bits bitmap, converted to the texture's pixel format
+ *         (RGBA, with the magenta color key turned transparent)
+ *   pcm - a 8 or 16 bits PCM wave, converted to the mixer's format (mono,
+ *         signed 16 bits, at PK_PCM_FREQ)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/packfmt.h"
+
+/** Color used as transparent on bitmaps */
+#define KEY_R 0xff
+#define KEY_G 0x00
+#define KEY_B 0xff
+
+#define ASSERT(stmt, retVal) \
+  do { \
+    if (!(stmt)) { \
+      rv = retVal; \
+      goto __ret; \
+    } \
+  } while (0)
+
+/** An asset to be packed */
+struct stAsset {
+    /** Its entry on the index */
+    packEntry entry;
+    /** Its (possibly converted) data */
+    unsigned char *pData;
+};
+typedef struct stAsset asset;
+
+/**
+ * Read a little-endian integer
+ */
+static int readInt(unsigned char *pBuf, int len) {
+    int i, val;
+    
+    val = 0;
+    i = len - 1;
+    while (i >= 0) {
+        val = (val << 8) | pBuf[i];
+        i--;
+    }
+    
+    return val;
+}
+
+/**
+ * Read a whole file
+ */
+static int readFile(unsigned char **ppData, int *pLen, char *pPath) {
+    FILE *pFp;
+    int rv;
+    
+    pFp = fopen(pPath, "rb");
+    ASSERT(pFp, 1);
+    
+    fseek(pFp, 0, SEEK_END);
+    *pLen = (int)ftell(pFp);
+    fseek(pFp, 0, SEEK_SET);
+    
+    *ppData = (unsigned char*)malloc(*pLen + 1);
+    ASSERT(*ppData, 1);
+    ASSERT(*pLen == 0 || fread(*ppData, *pLen, 1, pFp) == 1, 1);
+    
+    rv = 0;
+__ret:
+    if (pFp)
+        fclose(pFp);
+    
+    return rv;
+}
+
+/**
+ * Convert a bitmap file into RGBA pixels (top-down)
+ */
+static int convertBitmap(asset *pAsset, unsigned char *pFile, int len) {
+    unsigned char *pSrc, *pDst;
+    int bpp, height, stride, width, x, y, rv;
+    
+    ASSERT(len > 54 && pFile[0] == 'B' && pFile[1] == 'M', 1);
+    ASSERT(readInt(pFile + 30, 4) == 0 || readInt(pFile + 30, 4) == 3, 1);
+    
+    width = readInt(pFile + 18, 4);
+    height = readInt(pFile + 22, 4);
+    bpp = readInt(pFile + 28, 2) / 8;
+    ASSERT(width > 0 && height > 0, 1);
+    ASSERT(bpp == 3 || bpp == 4, 1);
+    
+    stride = (width * bpp + 3) & ~3;
+    pSrc = pFile + readInt(pFile + 10, 4);
+    ASSERT(pSrc + stride * height <= pFile + len, 1);
+    
+    pAsset->pData = (unsigned char*)malloc(width * height * 4);
+    ASSERT(pAsset->pData, 1);
+    
+    // Rows are stored bottom-up, as BGR(A)
+    y = 0;
+    while (y < height) {
+        unsigned char *pRow;
+        
+        pRow = pSrc + (height - 1 - y) * stride;
+        pDst = pAsset->pData + y * width * 4;
+        x = 0;
+        while (x < width) {
+            pDst[0] = pRow[2];
+            pDst[1] = pRow[1];
+            pDst[2] = pRow[0];
+            if (pRow[2] == KEY_R && pRow[1] == KEY_G && pRow[0] == KEY_B)
+                pDst[3] = 0x00;
+            else
+                pDst[3] = 0xff;
+            
+            pRow += bpp;
+            pDst += 4;
+            x++;
+        }
+        y++;
+    }
+    
+    pAsset->entry.width = width;
+    pAsset->entry.height = height;
+    pAsset->entry.size = width * height * 4;
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Convert a PCM wave file into the mixer's format: mono, signed 16 bits, at
+ * PK_PCM_FREQ (resampled linearly, if needed)
+ */
+static int convertWave(asset *pAsset, unsigned char *pFile, int len) {
+    unsigned char *pData, *pPos;
+    int bits, channels, dataLen, freq, frameLen, frames, i, outLen, rv;
+    
+    pData = 0;
+    dataLen = 0;
+    bits = 0;
+    channels = 0;
+    freq = 0;
+    
+    ASSERT(len > 12 && memcmp(pFile, "RIFF", 4) == 0 &&
+            memcmp(pFile + 8, "WAVE", 4) == 0, 1);
+    
+    // Find the format and the samples
+    pPos = pFile + 12;
+    while (pPos + 8 <= pFile + len) {
+        int chunkLen;
+        
+        chunkLen = readInt(pPos + 4, 4);
+        ASSERT(chunkLen >= 0 && pPos + 8 + chunkLen <= pFile + len, 1);
+        
+        if (memcmp(pPos, "fmt ", 4) == 0) {
+            ASSERT(chunkLen >= 16 && readInt(pPos + 8, 2) == 1, 1);
+            channels = readInt(pPos + 10, 2);
+            freq = readInt(pPos + 12, 4);
+            bits = readInt(pPos + 22, 2);
+        }
+        else if (memcmp(pPos, "data", 4) == 0) {
+            pData = pPos + 8;
+            dataLen = chunkLen;
+        }
+        
+        pPos += 8 + chunkLen + (chunkLen & 1);
+    }
+    ASSERT(pData && channels > 0 && freq > 0, 1);
+    ASSERT(bits == 8 || bits == 16, 1);
+    
+    frameLen = channels * bits / 8;
+    frames = dataLen / frameLen;
+    outLen = (int)((long long)frames * PK_PCM_FREQ / freq);
+    
+    pAsset->pData = (unsigned char*)malloc(outLen * 2 + 1);
+    ASSERT(pAsset->pData, 1);
+    
+    i = 0;
+    while (i < outLen) {
+        long long pos;
+        int frame, frac, j, val;
+        
+        // Position of the output sample on the input, in 16.16 fixed point
+        pos = (long long)i * freq * 65536 / PK_PCM_FREQ;
+        frame = (int)(pos >> 16);
+        frac = (int)(pos & 0xffff);
+        
+        val = 0;
+        j = 0;
+        while (j < 2) {
+            unsigned char *pFrame;
+            int ch, sum;
+            
+            // Interpolate between this frame and the next one
+            pFrame = pData + ((frame + j < frames) ? frame + j : frames - 1) *
+                    frameLen;
+            sum = 0;
+            ch = 0;
+            while (ch < channels) {
+                if (bits == 8)
+                    sum += (pFrame[ch] - 128) << 8;
+                else
+                    sum += (short)readInt(pFrame + ch * 2, 2);
+                ch++;
+            }
+            sum /= channels;
+            
+            if (j == 0)
+                val = sum * (65536 - frac) / 65536;
+            else
+                val += sum * frac / 65536;
+            j++;
+        }
+        
+        // Stored as little-endian
+        pAsset->pData[i * 2] = val & 0xff;
+        pAsset->pData[i * 2 + 1] = (val >> 8) & 0xff;
+        i++;
+    }
+
+    pAsset->entry.size = outLen * 2;
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Parse an argument ("name:format:path") and load its asset
+ */
+static int loadAsset(asset *pAsset, char *pArg) {
+    unsigned char *pFile;
+    char *pFormat, *pPath;
+    int len, rv;
+    
+    pFile = 0;
+    memset(pAsset, 0x0, sizeof(asset));
+    
+    pFormat = strchr(pArg, ':');
+    ASSERT(pFormat, 1);
+    *pFormat = '\0';
+    pFormat++;
+    pPath = strchr(pFormat, ':');
+    ASSERT(pPath, 1);
+    *pPath = '\0';
+    pPath++;
+    
+    ASSERT(strlen(pArg) < PK_NAME_LEN, 1);
+    strcpy(pAsset->entry.name, pArg);
+    
+    rv = readFile(&pFile, &len, pPath);
+    if (rv != 0) {
+        fprintf(stderr, "Failed to read '%s'\n", pPath);
+        ASSERT(0, 1);
+    }
+    
+    if (strcmp(pFormat, "raw") == 0) {
+        pAsset->entry.format = PK_FMT_RAW;
+        pAsset->entry.size = len;
+        pAsset->pData = pFile;
+        pFile = 0;
+    }
+    else if (strcmp(pFormat, "tex") == 0) {
+        pAsset->entry.format = PK_FMT_TEX;
+        rv = convertBitmap(pAsset, pFile, len);
+        if (rv != 0) {
+            fprintf(stderr, "'%s' isn't a valid bitmap\n", pPath);
+            ASSERT(0, 1);
+        }
+    }
+    else if (strcmp(pFormat, "pcm") == 0) {
+        pAsset->entry.format = PK_FMT_PCM;
+        rv = convertWave(pAsset, pFile, len);
+        if (rv != 0) {
+            fprintf(stderr, "'%s' isn't a valid PCM wave\n", pPath);
+            ASSERT(0, 1);
+        }
+    }
+    else {
+        fprintf(stderr, "Unknown format '%s'\n", pFormat);
+        ASSERT(0, 1);
+    }
+    
+    rv = 0;
+__ret:
+    if (pFile)
+        free(pFile);
+    
+    return rv;
+}
+
+int main(int argc, char *argv[]) {
+    static const unsigned char pZeros[PK_ALIGN] = {0};
+    packHeader hdr;
+    asset *pAssets;
+    FILE *pFp;
+    unsigned int offset;
+    int count, i, rv;
+    
+    pAssets = 0;
+    pFp = 0;
+    count = 0;
+    
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <out.pak> <name>:<format>:<path> [...]\n",
+                argv[0]);
+        ASSERT(0, 1);
+    }
+    
+    pAssets = (asset*)malloc(sizeof(asset) * (argc - 2));
+    ASSERT(pAssets, 1);
+    
+    // Load every asset and place it after the index
+    offset = sizeof(packHeader) + sizeof(packEntry) * (argc - 2);
+    while (count < argc - 2) {
+        rv = loadAsset(&pAssets[count], argv[count + 2]);
+        ASSERT(rv == 0, 1);
+        
+        offset = (offset + PK_ALIGN - 1) & ~(PK_ALIGN - 1);
+        pAssets[count].entry.offset = offset;
+        offset += pAssets[count].entry.size;
+        count++;
+    }
+    
+    pFp = fopen(argv[1], "wb");
+    ASSERT(pFp, 1);
+    
+    memset(&hdr, 0x0, sizeof(packHeader));
+    hdr.magic = PK_MAGIC;
+    hdr.count = count;
+    ASSERT(fwrite(&hdr, sizeof(packHeader), 1, pFp) == 1, 1);
+    
+    i = 0;
+    while (i < count) {
+        ASSERT(fwrite(&pAssets[i].entry, sizeof(packEntry), 1, pFp) == 1, 1);
+        i++;
+    }
+    
+    i = 0;
+    while (i < count) {
+        long pos;
+        
+        pos = ftell(pFp);
+        if (pos < pAssets[i].entry.offset)
+            ASSERT(fwrite(pZeros, pAssets[i].entry.offset - pos, 1, pFp) == 1,
+                    1);
+        if (pAssets[i].entry.size > 0)
+            ASSERT(fwrite(pAssets[i].pData, pAssets[i].entry.size, 1, pFp) ==
+                    1, 1);
+        i++;
+    }
+    
+    rv = 0;
+__ret:
+    if (pFp)
+        fclose(pFp);
+    if (rv != 0 && argc >= 3)
+        remove(argv[1]);
+    if (pAssets) {
+        i = 0;
+        while (i < count) {
+            free(pAssets[i].pData);
+            i++;
+        }
+        free(pAssets);
+    }
+    
+    return rv;
+}
@@ -0,0 +1,623 @@
+/**
+ * @file atlas_packer/atlas_packer.c
+ *
+ * Build-time tool that packs the source atlas into the one loaded by the game
+ * and generates a header mapping symbolic names to tile indices
+ *
+ * Usage: atlas_packer <src.bmp> <atlas.def> <dst.bmp> <tiles.h>
+ *
+ * Every non-empty line on the definition file describes a named region of the
+ * source atlas:
+ *   name width height index [count]
+ * where 'index' is the region's first tile (on a spriteset of 'width' x
+ * 'height' pixels) and 'count' is how many tiles it has (1, if omitted)
+ *
+ * Tiles that aren't on any region belong to the exported tilemaps, so they
+ * are kept at the same index (and so the packed atlas keeps the source's
+ * width). Every region is then either found on what was already packed (if
+ * it's an exact duplicate) or moved to the first place where it fits. The
+ * packed atlas' height is cropped to the smallest power of two that fits it
+ * all, and the header has the region's index on the packed atlas.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Color used as transparent on the source atlas */
+#define KEY_R 0xff
+#define KEY_G 0x00
+#define KEY_B 0xff
+
+/** Offsets into the bitmap's headers */
+#define BMP_FILESIZE    2
+#define BMP_DATAOFF     10
+#define BMP_WIDTH       18
+#define BMP_HEIGHT      22
+#define BMP_BPP         28
+#define BMP_COMPRESSION 30
+#define BMP_IMAGESIZE   34
+
+#define ASSERT(stmt, retVal) \
+  do { \
+    if (!(stmt)) { \
+      rv = retVal; \
+      goto __ret; \
+    } \
+  } while (0)
+
+/** A loaded bitmap; Pixels are kept as they are on the file (bottom-up) */
+struct stBitmap {
+    /** The whole file */
+    unsigned char *pFile;
+    /** Size of the file, in bytes */
+    int fileLen;
+    /** First pixel (of the last row) */
+    unsigned char *pData;
+    /** Bitmap's width, in pixels */
+    int width;
+    /** Bitmap's height, in pixels */
+    int height;
+    /** Bytes per pixel */
+    int bpp;
+    /** Bytes per row, padded to 4 bytes */
+    int stride;
+};
+typedef struct stBitmap bitmap;
+
+/** A named region, as defined on the definition file */
+struct stRegion {
+    /** Region's name */
+    char pName[128];
+    /** Tile's width, in pixels */
+    int tw;
+    /** Tile's height, in pixels */
+    int th;
+    /** First tile on the source atlas */
+    int src;
+    /** First tile on the packed atlas */
+    int dst;
+    /** How many tiles there are */
+    int count;
+};
+typedef struct stRegion region;
+
+/**
+ * Read a little-endian integer
+ */
+static int readInt(unsigned char *pBuf, int len) {
+    int i, val;
+    
+    val = 0;
+    i = len - 1;
+    while (i >= 0) {
+        val = (val << 8) | pBuf[i];
+        i--;
+    }
+    
+    return val;
+}
+
+/**
+ * Write a little-endian integer
+ */
+static void writeInt(unsigned char *pBuf, int len, int val) {
+    int i;
+    
+    i = 0;
+    while (i < len) {
+        pBuf[i] = val & 0xff;
+        val >>= 8;
+        i++;
+    }
+}
+
+/**
+ * Load an uncompressed 24 or 32 bits bitmap
+ */
+static int bmp_load(bitmap *pBmp, char *pFilename) {
+    FILE *pFp;
+    int rv;
+    
+    pFp = 0;
+    memset(pBmp, 0x0, sizeof(bitmap));
+    
+    pFp = fopen(pFilename, "rb");
+    ASSERT(pFp, 1);
+    
+    fseek(pFp, 0, SEEK_END);
+    pBmp->fileLen = (int)ftell(pFp);
+    fseek(pFp, 0, SEEK_SET);
+    ASSERT(pBmp->fileLen > BMP_IMAGESIZE + 4, 1);
+    
+    pBmp->pFile = (unsigned char*)malloc(pBmp->fileLen);
+    ASSERT(pBmp->pFile, 1);
+    ASSERT(fread(pBmp->pFile, pBmp->fileLen, 1, pFp) == 1, 1);
+    
+    ASSERT(pBmp->pFile[0] == 'B' && pBmp->pFile[1] == 'M', 1);
+    ASSERT(readInt(pBmp->pFile + BMP_COMPRESSION, 4) == 0 ||
+            readInt(pBmp->pFile + BMP_COMPRESSION, 4) == 3, 1);
+    
+    pBmp->width = readInt(pBmp->pFile + BMP_WIDTH, 4);
+    pBmp->height = readInt(pBmp->pFile + BMP_HEIGHT, 4);
+    pBmp->bpp = readInt(pBmp->pFile + BMP_BPP, 2) / 8;
+    ASSERT(pBmp->bpp == 3 || pBmp->bpp == 4, 1);
+    // Top-down bitmaps aren't supported
+    ASSERT(pBmp->height > 0, 1);
+    ASSERT(pBmp->width % 8 == 0 && pBmp->height % 8 == 0, 1);
+    
+    pBmp->stride = (pBmp->width * pBmp->bpp + 3) & ~3;
+    pBmp->pData = pBmp->pFile + readInt(pBmp->pFile + BMP_DATAOFF, 4);
+    ASSERT(pBmp->pData + pBmp->stride * pBmp->height <=
+            pBmp->pFile + pBmp->fileLen, 1);
+    
+    rv = 0;
+__ret:
+    if (pFp)
+        fclose(pFp);
+    
+    return rv;
+}
+
+/**
+ * Get a pixel (with 0,0 being the top-left corner)
+ */
+static unsigned char* bmp_getPixel(bitmap *pBmp, int x, int y) {
+    return pBmp->pData + (pBmp->height - 1 - y) * pBmp->stride + x * pBmp->bpp;
+}
+
+/**
+ * Check whether a pixel is transparent
+ */
+static int bmp_isKey(unsigned char *pPx) {
+    return pPx[0] == KEY_B && pPx[1] == KEY_G && pPx[2] == KEY_R;
+}
+
+/**
+ * Get the top-left pixel of a tile on a spriteset of 'tw' x 'th' pixels
+ */
+static void getTilePos(int *pX, int *pY, int width, int tw, int th,
+        int tile) {
+    *pX = (tile % (width / tw)) * tw;
+    *pY = (tile / (width / tw)) * th;
+}
+
+/**
+ * Check whether every pixel on a region's tiles (if placed at 'tile') is
+ * inside the atlas and in use (or free, if 'isUsed' is 0)
+ */
+static int isRegionUsed(unsigned char *pUsed, bitmap *pBmp, region *pReg,
+        int tile, int isUsed) {
+    int i, x, y, tx, ty;
+    
+    i = 0;
+    while (i < pReg->count) {
+        getTilePos(&tx, &ty, pBmp->width, pReg->tw, pReg->th, tile + i);
+        if (ty + pReg->th > pBmp->height)
+            return 0;
+        
+        y = 0;
+        while (y < pReg->th) {
+            x = 0;
+            while (x < pReg->tw) {
+                if (pUsed[(ty + y) * pBmp->width + tx + x] != isUsed)
+                    return 0;
+                x++;
+            }
+            y++;
+        }
+        i++;
+    }
+    
+    return 1;
+}
+
+/**
+ * Check whether a region's tiles on the source are the same as the ones
+ * starting at 'tile' on the destination
+ */
+static int isRegionEqual(bitmap *pSrc, bitmap *pDst, region *pReg, int tile) {
+    int i, y, sx, sy, dx, dy;
+    
+    i = 0;
+    while (i < pReg->count) {
+        getTilePos(&sx, &sy, pSrc->width, pReg->tw, pReg->th, pReg->src + i);
+        getTilePos(&dx, &dy, pDst->width, pReg->tw, pReg->th, tile + i);
+        
+        y = 0;
+        while (y < pReg->th) {
+            if (memcmp(bmp_getPixel(pSrc, sx, sy + y),
+                    bmp_getPixel(pDst, dx, dy + y), pReg->tw * pSrc->bpp) != 0)
+                return 0;
+            y++;
+        }
+        i++;
+    }
+    
+    return 1;
+}
+
+/**
+ * Mark every pixel of a region's tiles (if placed at 'tile')
+ */
+static void markRegion(unsigned char *pUsed, int width, region *pReg,
+        int tile) {
+    int i, y, tx, ty;
+    
+    i = 0;
+    while (i < pReg->count) {
+        getTilePos(&tx, &ty, width, pReg->tw, pReg->th, tile + i);
+        
+        y = 0;
+        while (y < pReg->th) {
+            memset(pUsed + (ty + y) * width + tx, 1, pReg->tw);
+            y++;
+        }
+        i++;
+    }
+}
+
+/**
+ * Copy a region's tiles from the source to 'tile' on the destination and
+ * mark them as used
+ */
+static void copyRegion(unsigned char *pUsed, bitmap *pSrc, bitmap *pDst,
+        region *pReg, int tile) {
+    int i, y, sx, sy, dx, dy;
+    
+    i = 0;
+    while (i < pReg->count) {
+        getTilePos(&sx, &sy, pSrc->width, pReg->tw, pReg->th, pReg->src + i);
+        getTilePos(&dx, &dy, pDst->width, pReg->tw, pReg->th, tile + i);
+        
+        y = 0;
+        while (y < pReg->th) {
+            memcpy(bmp_getPixel(pDst, dx, dy + y),
+                    bmp_getPixel(pSrc, sx, sy + y), pReg->tw * pSrc->bpp);
+            y++;
+        }
+        i++;
+    }
+    markRegion(pUsed, pDst->width, pReg, tile);
+}
+
+/**
+ * Parse every region on the definition file
+ */
+static int readRegions(region **ppRegs, int *pLen, bitmap *pBmp,
+        char *pDefFile) {
+    FILE *pIn;
+    char pLine[256];
+    int lineNum, regsLen, rv;
+    
+    pIn = 0;
+    *ppRegs = 0;
+    *pLen = 0;
+    regsLen = 0;
+    
+    pIn = fopen(pDefFile, "rt");
+    ASSERT(pIn, 1);
+    
+    lineNum = 0;
+    while (fgets(pLine, sizeof(pLine), pIn)) {
+        char pName[128];
+        region *pReg;
+        int ret, tx, ty;
+        
+        lineNum++;
+        
+        // Skip comments and empty lines
+        ret = sscanf(pLine, " %127s", pName);
+        if (ret != 1 || pName[0] == '#')
+            continue;
+        
+        // Expand the regions, if needed
+        if (*pLen >= regsLen) {
+            regsLen += 16;
+            *ppRegs = (region*)realloc(*ppRegs, sizeof(region) * regsLen);
+            ASSERT(*ppRegs, 1);
+        }
+        pReg = &(*ppRegs)[*pLen];
+        memset(pReg, 0x0, sizeof(region));
+        
+        pReg->count = 1;
+        ret = sscanf(pLine, " %127s %i %i %i %i", pReg->pName, &pReg->tw,
+                &pReg->th, &pReg->src, &pReg->count);
+        if (ret < 4 || pReg->tw <= 0 || pReg->th <= 0 || pReg->src < 0 ||
+                pReg->count <= 0 || pBmp->width % pReg->tw != 0) {
+            fprintf(stderr, "%s:%i: expected 'name width height index "
+                    "[count]'\n", pDefFile, lineNum);
+            ASSERT(0, 1);
+        }
+        
+        // Check that the whole region is on the source
+        getTilePos(&tx, &ty, pBmp->width, pReg->tw, pReg->th,
+                pReg->src + pReg->count - 1);
+        if (ty + pReg->th > pBmp->height) {
+            fprintf(stderr, "%s:%i: '%s' is outside the source atlas\n",
+                    pDefFile, lineNum, pReg->pName);
+            ASSERT(0, 1);
+        }
+        
+        (*pLen)++;
+    }
+    
+    rv = 0;
+__ret:
+    if (pIn)
+        fclose(pIn);
+    
+    return rv;
+}
+
+/**
+ * Write only the top 'height' rows of the bitmap, keeping its headers
+ */
+static int bmp_writeCropped(bitmap *pBmp, int height, char *pFilename) {
+    unsigned char *pHeader;
+    FILE *pFp;
+    int dataOff, rv;
+    
+    pFp = 0;
+    pHeader = 0;
+    dataOff = (int)(pBmp->pData - pBmp->pFile);
+    
+    // Copy the headers, updating the dimensions
+    pHeader = (unsigned char*)malloc(dataOff);
+    ASSERT(pHeader, 1);
+    memcpy(pHeader, pBmp->pFile, dataOff);
+    writeInt(pHeader + BMP_FILESIZE, 4, dataOff + pBmp->stride * height);
+    writeInt(pHeader + BMP_HEIGHT, 4, height);
+    writeInt(pHeader + BMP_IMAGESIZE, 4, pBmp->stride * height);
+    
+    pFp = fopen(pFilename, "wb");
+    ASSERT(pFp, 1);
+    ASSERT(fwrite(pHeader, dataOff, 1, pFp) == 1, 1);
+    // Rows are stored bottom-up, so the top ones are at the end
+    ASSERT(fwrite(bmp_getPixel(pBmp, 0, height - 1), pBmp->stride * height, 1,
+            pFp) == 1, 1);
+    
+    rv = 0;
+__ret:
+    if (pFp)
+        fclose(pFp);
+    if (pHeader)
+        free(pHeader);
+    
+    return rv;
+}
+
+/**
+ * Write the header with every region's packed index
+ */
+static int writeHeader(bitmap *pBmp, int height, region *pRegs, int len,
+        char *pDefFile, char *pDstFile) {
+    FILE *pOut;
+    int i, rv;
+    
+    pOut = fopen(pDstFile, "wt");
+    ASSERT(pOut, 1);
+    
+    fprintf(pOut, "/**\n");
+    fprintf(pOut, " * @file src/tiles.h\n");
+    fprintf(pOut, " *\n");
+    fprintf(pOut, " * Generated by atlas_packer from %s; Don't modify it by "
+            "hand!\n", pDefFile);
+    fprintf(pOut, " */\n");
+    fprintf(pOut, "#ifndef __TILES_H__\n");
+    fprintf(pOut, "#define __TILES_H__\n");
+    fprintf(pOut, "\n");
+    fprintf(pOut, "/** Packed atlas' dimensions */\n");
+    fprintf(pOut, "#define ATLAS_W %i\n", pBmp->width);
+    fprintf(pOut, "#define ATLAS_H %i\n", height);
+    fprintf(pOut, "\n");
+    
+    i = 0;
+    while (i < len) {
+        fprintf(pOut, "#define TL_%s %i\n", pRegs[i].pName, pRegs[i].dst);
+        if (pRegs[i].count > 1)
+            fprintf(pOut, "#define TL_%s_LEN %i\n", pRegs[i].pName,
+                    pRegs[i].count);
+        i++;
+    }
+    
+    fprintf(pOut, "\n");
+    fprintf(pOut, "#endif /* __TILES_H__ */\n");
+    fprintf(pOut, "\n");
+    
+    rv = 0;
+__ret:
+    if (pOut)
+        fclose(pOut);
+    
+    return rv;
+}
+
+int main(int argc, char *argv[]) {
+    bitmap src, dst;
+    region *pRegs;
+    unsigned char *pKept, *pUsed;
+    int dups, height, i, kept, len, rv, tile, tiles, tilesW, x, y;
+    
+    memset(&src, 0x0, sizeof(bitmap));
+    memset(&dst, 0x0, sizeof(bitmap));
+    pRegs = 0;
+    pKept = 0;
+    pUsed = 0;
+    
+    if (argc != 5) {
+        fprintf(stderr, "Usage: %s <src.bmp> <atlas.def> <dst.bmp> "
+                "<tiles.h>\n", argv[0]);
+        ASSERT(0, 1);
+    }
+    
+    rv = bmp_load(&src, argv[1]);
+    if (rv != 0) {
+        fprintf(stderr, "Failed to load '%s'\n", argv[1]);
+        ASSERT(0, 1);
+    }
+    rv = readRegions(&pRegs, &len, &src, argv[2]);
+    ASSERT(rv == 0, 1);
+    
+    tilesW = src.width / 8;
+    tiles = tilesW * (src.height / 8);
+    pKept = (unsigned char*)malloc(tiles);
+    ASSERT(pKept, 1);
+    pUsed = (unsigned char*)malloc(src.width * src.height);
+    ASSERT(pUsed, 1);
+    
+    // Find every tile with anything outside the regions
+    memset(pUsed, 0x0, src.width * src.height);
+    i = 0;
+    while (i < len) {
+        markRegion(pUsed, src.width, &pRegs[i], pRegs[i].src);
+        i++;
+    }
+    tile = 0;
+    while (tile < tiles) {
+        pKept[tile] = 0;
+        y = 0;
+        while (!pKept[tile] && y < 8) {
+            x = 0;
+            while (!pKept[tile] && x < 8) {
+                int px, py;
+                
+                px = (tile % tilesW) * 8 + x;
+                py = (tile / tilesW) * 8 + y;
+                pKept[tile] = !pUsed[py * src.width + px] &&
+                        !bmp_isKey(bmp_getPixel(&src, px, py));
+                x++;
+            }
+            y++;
+        }
+        tile++;
+    }
+    
+    // The destination starts as a transparent copy of the source
+    dst = src;
+    dst.pFile = (unsigned char*)malloc(src.fileLen);
+    ASSERT(dst.pFile, 1);
+    memcpy(dst.pFile, src.pFile, src.fileLen);
+    dst.pData = dst.pFile + (src.pData - src.pFile);
+    y = 0;
+    while (y < dst.height) {
+        x = 0;
+        while (x < dst.width) {
+            unsigned char *pPx;
+            
+            pPx = bmp_getPixel(&dst, x, y);
+            pPx[0] = KEY_B;
+            pPx[1] = KEY_G;
+            pPx[2] = KEY_R;
+            if (dst.bpp == 4)
+                pPx[3] = 0xff;
+            x++;
+        }
+        y++;
+    }
+    
+    // Kept tiles stay where they are (as the tilemaps refer to them)
+    memset(pUsed, 0x0, src.width * src.height);
+    kept = 0;
+    tile = 0;
+    while (tile < tiles) {
+        if (pKept[tile]) {
+            region reg;
+            
+            memset(&reg, 0x0, sizeof(region));
+            reg.tw = 8;
+            reg.th = 8;
+            reg.src = tile;
+            reg.count = 1;
+            copyRegion(pUsed, &src, &dst, &reg, tile);
+            kept++;
+        }
+        tile++;
+    }
+    
+    // Either reuse an identical copy of each region or pack it on the first
+    // place where it fits
+    dups = 0;
+    i = 0;
+    while (i < len) {
+        region *pReg;
+        int maxTile;
+        
+        pReg = &pRegs[i];
+        maxTile = (src.width / pReg->tw) * (src.height / pReg->th) -
+                pReg->count;
+        
+        tile = 0;
+        while (tile <= maxTile) {
+            if (isRegionUsed(pUsed, &dst, pReg, tile, 1/*isUsed*/) &&
+                    isRegionEqual(&src, &dst, pReg, tile))
+                break;
+            tile++;
+        }
+        if (tile <= maxTile)
+            dups++;
+        else {
+            tile = 0;
+            while (tile <= maxTile) {
+                if (isRegionUsed(pUsed, &dst, pReg, tile, 0/*isUsed*/))
+                    break;
+                tile++;
+            }
+            if (tile > maxTile) {
+                fprintf(stderr, "'%s' doesn't fit on the packed atlas\n",
+                        pReg->pName);
+                ASSERT(0, 1);
+            }
+            copyRegion(pUsed, &src, &dst, pReg, tile);
+        }
+        pReg->dst = tile;
+        i++;
+    }
+    
+    // Find the last row in use and round it up to a power of two
+    height = 0;
+    y = 0;
+    while (y < src.height) {
+        x = 0;
+        while (x < src.width) {
+            if (pUsed[y * src.width + x]) {
+                height = y + 1;
+                break;
+            }
+            x++;
+        }
+        y++;
+    }
+    i = 8;
+    while (i < height)
+        i <<= 1;
+    height = i;
+    
+    fprintf(stderr, "%ix%i -> %ix%i (%i tiles kept, %i regions packed, %i "
+            "duplicated)\n", src.width, src.height, dst.width, height, kept,
+            len - dups, dups);
+    
+    rv = bmp_writeCropped(&dst, height, argv[3]);
+    if (rv != 0) {
+        fprintf(stderr, "Failed to write '%s'\n", argv[3]);
+        ASSERT(0, 1);
+    }
+    
+    rv = writeHeader(&dst, height, pRegs, len, argv[2], argv[4]);
+    ASSERT(rv == 0, 1);
+    
+    rv = 0;
+__ret:
+    if (src.pFile)
+        free(src.pFile);
+    if (dst.pFile)
+        free(dst.pFile);
+    if (pRegs)
+        free(pRegs);
+    if (pKept)
+        free(pKept);
+    if (pUsed)
+        free(pUsed);
+    
+    return rv;
+}
+
@@ -3,65 +3,180 @@
  * 
  * audio module
  */
-#include <GFraMe/GFraMe_audio_player.h>
+#ifdef DEBUG
+#  include <stdio.h>
+#endif
+
+#include <math.h>
 
 #include "audio.h"
+#include "camera.h"
 #include "global.h"
+#include "mixer.h"
+#include "music.h"
 
 static const double sfx_vol = 0.6;
 static const double song_vol = 0.8;
 
+#ifndef MUTED
+/** Camera that hears positional sounds */
+static camera *_audListener = 0;
+#endif
+
+void aud_setListener(camera *pCam) {
+#ifndef MUTED
+    _audListener = pCam;
+#endif
+}
+
+#ifndef MUTED
+/**
+ * Attenuate a sound by its distance from the camera's center; Past
+ * AUD_CUTOFF_DIST, it's completely mute
+ */
+static double aud_getVolume(double volume, int x, int y) {
+    int cx, cy, dx, dy, dist2, h, w;
+    
+    if (x == AUD_NO_POS || !_audListener)
+        return volume;
+    
+    cam_getPos(&cx, &cy, _audListener);
+    cam_getDimensions(&w, &h, _audListener);
+    dx = x - (cx + w / 2);
+    dy = y - (cy + h / 2);
+    dist2 = dx * dx + dy * dy;
+    
+    // Only sounds that are partially attenuated need the actual distance
+    if (dist2 >= AUD_CUTOFF_DIST * AUD_CUTOFF_DIST)
+        return 0.0;
+    else if (dist2 <= AUD_FULL_DIST * AUD_FULL_DIST)
+        return volume;
+    return volume * (AUD_CUTOFF_DIST - sqrt((double)dist2)) /
+            (AUD_CUTOFF_DIST - AUD_FULL_DIST);
+}
+
+/**
+ * Play a sound at a position; Inaudible ones never reach the mixer (so they
+ * are neither loaded nor take a voice)
+ */
+static void aud_playAt(mixClip *pClip, double volume, mixCategory category,
+        int x, int y) {
+    volume = aud_getVolume(volume, x, y);
+    if (volume > 0.0)
+        mix_play(pClip, volume, category);
+}
+#endif
+
 void aud_playSong() {
 #ifndef MUTED
-    GFraMe_audio_player_play_bgm(gl_aud_song1, song_vol);
+    // The song is only decoded if it couldn't be streamed
+    if (gl_aud_song1)
+        mix_play(gl_aud_song1, song_vol, MIX_CAT_MUSIC);
+    else
+        mus_play(song_vol);
 #endif
 }
 
 void aud_playText() {
 #ifndef MUTED
-    GFraMe_audio_player_push(gl_aud_text, sfx_vol * 0.5);
+    mix_play(gl_aud_text, sfx_vol * 0.5, MIX_CAT_UI);
 #endif
 }
 
-void aud_playPlStep() {
+void aud_playPlStep(int x, int y) {
 #ifndef MUTED
-    GFraMe_audio_player_push(gl_aud_step, sfx_vol * 0.425);
+    aud_playAt(gl_aud_step, sfx_vol * 0.425, MIX_CAT_STEP, x, y);
 #endif
 }
 
-void aud_playPlFall() {
+void aud_playPlFall(int x, int y) {
 #ifndef MUTED
-    GFraMe_audio_player_push(gl_aud_step, sfx_vol);
+    aud_playAt(gl_aud_step, sfx_vol, MIX_CAT_STEP, x, y);
 #endif
 }
 
-void aud_playBlBullet() {
+void aud_playBlBullet(int x, int y) {
 #ifndef MUTED
-    GFraMe_audio_player_push(gl_aud_bullet, sfx_vol*0.15);
+    aud_playAt(gl_aud_bullet, sfx_vol*0.15, MIX_CAT_WEAPON, x, y);
 #endif
 }
 
-void aud_playPlDeath() {
+void aud_playPlDeath(int x, int y) {
 #ifndef MUTED
-    GFraMe_audio_player_push(gl_aud_death, sfx_vol);
+    aud_playAt(gl_aud_death, sfx_vol, MIX_CAT_EVENT, x, y);
 #endif
 }
 
-void aud_playPlJump() {
+void aud_playPlJump(int x, int y) {
 #ifndef MUTED
-    GFraMe_audio_player_push(gl_aud_jump, sfx_vol);
+    aud_playAt(gl_aud_jump, sfx_vol, MIX_CAT_EVENT, x, y);
 #endif
 }
 
 void aud_playPlGetStone() {
 #ifndef MUTED
-    GFraMe_audio_player_push(gl_aud_powerup, sfx_vol);
+    mix_play(gl_aud_powerup, sfx_vol, MIX_CAT_EVENT);
 #endif
 }
 
 void aud_playPlRevive() {
 #ifndef MUTED
-    GFraMe_audio_player_push(gl_aud_revive, sfx_vol);
+    mix_play(gl_aud_revive, sfx_vol, MIX_CAT_EVENT);
 #endif
 }
 
+void aud_prefetchPlGetStone() {
+#ifndef MUTED
+    mix_prefetch(gl_aud_powerup);
+#endif
+}
+
+void aud_prefetchPlRevive() {
+#ifndef MUTED
+    mix_prefetch(gl_aud_revive);
+#endif
+}
+
+#ifdef DEBUG
+/**
+ * Print a histogram's non-empty buckets
+ */
+static void aud_printHistogram(char *pName, Uint32 *pHist) {
+    int i;
+    
+    printf("  %s:\n", pName);
+    i = 0;
+    while (i < MIX_STATS_BUCKETS) {
+        if (pHist[i] > 0 && i < MIX_STATS_BUCKETS - 1)
+            printf("    < %6u us: %u\n", 1u << i, pHist[i]);
+        else if (pHist[i] > 0)
+            printf("    >= %5u us: %u\n", 1u << (i - 1), pHist[i]);
+        i++;
+    }
+}
+
+/**
+ * Print the audio's instrumentation
+ */
+void aud_dumpStats() {
+    mixStats mix;
+    musStats mus;
+    
+    mix_getStats(&mix);
+    mus_getStats(&mus);
+    
+    printf("mixer: %u callbacks (longest %u us), %u underruns\n",
+            mix.callbacks, mix.maxCallback, mix.underruns);
+    printf("  up to %i voices; %u merged, %u stolen, %u dropped\n",
+            mix.maxVoices, mix.merged, mix.stolen, mix.dropped);
+    printf("  (plus %i samples buffered by the device)\n", MIX_DEV_SAMPLES);
+    aud_printHistogram("latency from trigger to mix", mix.pLatency);
+    aud_printHistogram("callback duration", mix.pCallback);
+    
+    printf("music: %u callbacks (longest %u us), %u underruns\n",
+            mus.callbacks, mus.maxCallback, mus.underruns);
+    if (mus.callbacks > 0)
+        printf("  ring fill: %u min, %u avg (of %i bytes)\n", mus.minFill,
+                (Uint32)(mus.totalFill / mus.callbacks), MUS_RING_LEN);
+}
+#endif /* DEBUG */
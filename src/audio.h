@@ -6,15 +6,43 @@
 #ifndef __AUDIO_H__
 #define __AUDIO_H__
 
+#include "camera.h"
+
+/** Position of a sound heard at full volume, wherever the camera is */
+#define AUD_NO_POS (-0x7fffffff)
+
+/**
+ * Set the camera that hears positional sounds; Those are attenuated by their
+ * distance from its center and skipped beyond AUD_CUTOFF_DIST
+ */
+void aud_setListener(camera *pCam);
+
 void aud_playSong();
 void aud_playText();
-void aud_playPlStep();
-void aud_playPlFall();
-void aud_playBlBullet();
-void aud_playPlDeath();
-void aud_playPlJump();
+/**
+ * Positional sounds; 'x' and 'y' are on world space (or AUD_NO_POS)
+ */
+void aud_playPlStep(int x, int y);
+void aud_playPlFall(int x, int y);
+void aud_playBlBullet(int x, int y);
+void aud_playPlDeath(int x, int y);
+void aud_playPlJump(int x, int y);
 void aud_playPlGetStone();
 void aud_playPlRevive();
 
+/**
+ * Hint that a sound is about to be played, so it's loaded on the background
+ */
+void aud_prefetchPlGetStone();
+void aud_prefetchPlRevive();
+
+#ifdef DEBUG
+/**
+ * Print the audio's instrumentation (latency, callbacks' duration, underruns
+ * and buffers' fill level)
+ */
+void aud_dumpStats();
+#endif /* DEBUG */
+
 #endif /* __AUDIO_H__ */
 
@@ -32,6 +32,8 @@ struct stCamera {
     int deadWidth;
     /** Dead zone's height */
     int deadHeight;
+    /** View on the last snapshot */
+    camView view;
 };
 
 /**
@@ -82,6 +84,11 @@ void cam_init(camera *pCam, int viewWidth, int viewHeight, int worldWidth, int w
     pCam->viewHeight = viewHeight;
     pCam->worldWidth = worldWidth;
     pCam->worldHeight = worldHeight;
+    
+    cam_snapshot(pCam);
+    pCam->view.prevX = pCam->view.x;
+    pCam->view.prevY = pCam->view.y;
+    cam_interpolate(pCam, INTERP_ONE);
 __ret:
     return;
 }
@@ -207,11 +214,91 @@ __ret:
 }
 
 /**
- * Returns whether an object is inside a camera
+ * Update the camera's view; Must be called whenever the camera is moved
+ */
+void cam_snapshot(camera *pCam) {
+    camView *pView;
+    
+    // Check the arguments
+    ASSERT_NR(pCam);
+    
+    pView = &pCam->view;
+    pView->prevX = pView->x;
+    pView->prevY = pView->y;
+    pView->x = pCam->x;
+    pView->y = pCam->y;
+    pView->w = pCam->viewWidth;
+    pView->h = pCam->viewHeight;
+__ret:
+    return;
+}
+
+/**
+ * Set how far into the next update the current draw is, interpolating the
+ * view's position
+ */
+void cam_interpolate(camera *pCam, int alpha) {
+    camView *pView;
+    int dx, dy;
+    
+    // Check the arguments
+    ASSERT_NR(pCam);
+    
+    pView = &pCam->view;
+    pView->alpha = alpha;
+    
+    dx = pView->x - pView->prevX;
+    dy = pView->y - pView->prevY;
+    if (dx > INTERP_MAX_DIST || dx < -INTERP_MAX_DIST ||
+            dy > INTERP_MAX_DIST || dy < -INTERP_MAX_DIST) {
+        dx = 0;
+        dy = 0;
+    }
+    pView->drawX = pView->x - dx * (INTERP_ONE - alpha) / INTERP_ONE;
+    pView->drawY = pView->y - dy * (INTERP_ONE - alpha) / INTERP_ONE;
+    
+    // Get the tiles at the position that will actually be rendered
+    pView->tileIniX = pView->drawX / 8;
+    pView->tileIniY = pView->drawY / 8;
+    pView->tileEndX = (pView->drawX + pView->w + 7) / 8;
+    pView->tileEndY = (pView->drawY + pView->h + 7) / 8;
+    if (pView->tileIniX < 0)
+        pView->tileIniX = 0;
+    if (pView->tileIniY < 0)
+        pView->tileIniY = 0;
+    if (pView->tileEndX > pCam->worldWidth / 8)
+        pView->tileEndX = pCam->worldWidth / 8;
+    if (pView->tileEndY > pCam->worldHeight / 8)
+        pView->tileEndY = pCam->worldHeight / 8;
+__ret:
+    return;
+}
+
+/**
+ * Get the view taken on the last snapshot
+ */
+const camView* cam_getView(camera *pCam) {
+    return &pCam->view;
+}
+
+/**
+ * Returns whether an object's hitbox intersects the camera's view, on any
+ * position where either may be rendered until the next snapshot
  */
 int cam_isInside(camera *pCam, GFraMe_object *pObj) {
-    // TODO cam_isInside
-    return 1;
+    const camView *pView;
+    int hh, hw, x, y;
+    
+    pView = &pCam->view;
+    x = pObj->x + pObj->hitbox.cx;
+    y = pObj->y + pObj->hitbox.cy;
+    // Both the view and the object may be rendered up to INTERP_MAX_DIST
+    // behind their current positions
+    hw = pObj->hitbox.hw + 2 * INTERP_MAX_DIST;
+    hh = pObj->hitbox.hh + 2 * INTERP_MAX_DIST;
+    
+    return x + hw >= pView->x && x - hw <= pView->x + pView->w &&
+            y + hh >= pView->y && y - hh <= pView->y + pView->h;
 }
 
 /**
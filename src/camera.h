@@ -11,6 +11,39 @@
 /** 'Export' the camera structure */
 typedef struct stCamera camera;
 
+/** What the camera sees on the current frame; Taken once per frame, so every
+ * culling test reads it directly instead of querying the camera */
+typedef struct stCamView camView;
+struct stCamView {
+    /** View's position into the world */
+    int x;
+    /** View's position into the world */
+    int y;
+    /** View's width */
+    int w;
+    /** View's height */
+    int h;
+    /** First visible tile, at the interpolated position */
+    int tileIniX;
+    /** First visible tile, at the interpolated position */
+    int tileIniY;
+    /** Last visible tile (exclusive, and clamped to the world) */
+    int tileEndX;
+    /** Last visible tile (exclusive, and clamped to the world) */
+    int tileEndY;
+    /** Position on the previous snapshot */
+    int prevX;
+    /** Position on the previous snapshot */
+    int prevY;
+    /** How far into the next update the current draw is (from 0 to
+     * INTERP_ONE) */
+    int alpha;
+    /** Position interpolated between the previous and the current snapshot */
+    int drawX;
+    /** Position interpolated between the previous and the current snapshot */
+    int drawY;
+};
+
 /**
  * Alloc a new camera 'object'
  */
@@ -53,7 +86,24 @@ void cam_setDeadzone(camera *pCam, int width, int height);
 int cam_centerAt(camera *pCam, int x, int y);
 
 /**
- * Returns whether an object is inside a camera
+ * Update the camera's view; Must be called whenever the camera is moved
+ */
+void cam_snapshot(camera *pCam);
+
+/**
+ * Set how far into the next update the current draw is, interpolating the
+ * view's position (and updating its visible tiles)
+ */
+void cam_interpolate(camera *pCam, int alpha);
+
+/**
+ * Get the view taken on the last snapshot
+ */
+const camView* cam_getView(camera *pCam);
+
+/**
+ * Returns whether an object's hitbox intersects the camera's view, on any
+ * position where either may be rendered until the next snapshot
  */
 int cam_isInside(camera *pCam, GFraMe_object *pObj);
 
@@ -47,12 +47,6 @@ void collPlSpr(sprite *pSprPl, sprite *pSpr, sprType type) {
             pl_addStone(pPl, type);
             spr_setType(pSpr, SPR_CHECKPOINT);
         break;
-        case SPR_CHECKPOINT:
-            pl_setCheckpoint(pPl);
-        break;
-        case SPR_SPIKE:
-            pl_kill(pPl);
-        break;
         default: {}
     }
 }
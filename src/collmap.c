@@ -0,0 +1,517 @@
+/**
+ * @file src/collmap.c
+ *
+ * Per-tile collision flags (solid, hazard and checkpoint), so checking a box
+ * against the world only looks up the tiles under it, no matter how many walls
+ * or spikes the map has
+ *
+ * Solids are aligned to the tiles; Other flags may be added as areas, which
+ * only apply inside their exact bounds; Each tile keeps a list of the areas
+ * over it, so only those are tested
+ */
+#include <GFraMe/GFraMe_hitbox.h>
+#include <GFraMe/GFraMe_object.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "collmap.h"
+#include "global.h"
+
+/** Flags that only apply inside an exact rectangle */
+struct stCmArea {
+    /** Left side, in pixels */
+    int x;
+    /** Top side, in pixels */
+    int y;
+    /** Width, in pixels */
+    int w;
+    /** Height, in pixels */
+    int h;
+    /** The area's cmFlags */
+    int flags;
+};
+typedef struct stCmArea cmArea;
+
+/** A rectangle of solid tiles, in tiles */
+struct stCmRect {
+    /** Leftmost tile */
+    int x;
+    /** Topmost tile */
+    int y;
+    /** Width, in tiles */
+    int w;
+    /** Height, in tiles (0 once it's merged into the one above it) */
+    int h;
+};
+typedef struct stCmRect cmRect;
+
+/** An entry on a tile's list of areas */
+struct stCmNode {
+    /** Index of the area */
+    int area;
+    /** Index of the tile's next node, or -1 */
+    int next;
+};
+typedef struct stCmNode cmNode;
+
+/** 'Export' the collision map structure */
+struct stCollMap {
+    /** Every tile's cmFlags (either set directly or by an area) */
+    unsigned char *pFlags;
+    /** Tiles whose flags were set directly, so they need no further test */
+    unsigned char *pExact;
+    /** Index of the first node on every tile's list of areas, or -1 */
+    int *pTileNodes;
+    /** How many tiles there are allocated */
+    int flagsLen;
+    /** Map width, in tiles */
+    int width;
+    /** Map height, in tiles */
+    int height;
+    /** Rectangles of solid tiles found by the last query */
+    cmRect *pRects;
+    /** Rectangles of solid tiles returned by the last query */
+    GFraMe_object *pRuns;
+    /** Pointers to every rectangle, as returned by the last query */
+    GFraMe_object **ppHits;
+    /** How many rectangles there are allocated (on every buffer) */
+    int runsLen;
+    /** Every area added to the map */
+    cmArea *pAreas;
+    /** How many areas there are in use */
+    int areasUsed;
+    /** How many areas there are allocated */
+    int areasLen;
+    /** Nodes of every tile's list of areas */
+    cmNode *pNodes;
+    /** How many nodes there are in use */
+    int nodesUsed;
+    /** How many nodes there are allocated */
+    int nodesLen;
+};
+
+/**
+ * Get the (clamped) tiles that a box overlaps, in [ini, end); Returns 0 if
+ * the box is completely outside the map
+ */
+static int cm_getTiles(int *pIniX, int *pIniY, int *pEndX, int *pEndY,
+        collMap *pCm, int x, int y, int w, int h) {
+    if (w <= 0 || h <= 0)
+        return 0;
+    
+    // Shift it, so negative positions are rounded down
+    *pIniX = (x + 8 * pCm->width) / 8 - pCm->width;
+    *pIniY = (y + 8 * pCm->height) / 8 - pCm->height;
+    *pEndX = (x + w - 1 + 8 * pCm->width) / 8 - pCm->width + 1;
+    *pEndY = (y + h - 1 + 8 * pCm->height) / 8 - pCm->height + 1;
+    
+    if (*pIniX < 0)
+        *pIniX = 0;
+    if (*pIniY < 0)
+        *pIniY = 0;
+    if (*pEndX > pCm->width)
+        *pEndX = pCm->width;
+    if (*pEndY > pCm->height)
+        *pEndY = pCm->height;
+    
+    return *pIniX < *pEndX && *pIniY < *pEndY;
+}
+
+/**
+ * Alloc a new collision map
+ */
+int cm_getNew(collMap **ppCm) {
+    int rv;
+    
+    // Check params
+    ASSERT(ppCm, 1);
+    ASSERT(!(*ppCm), 1);
+    
+    // Alloc the map
+    *ppCm = (collMap*)malloc(sizeof(collMap));
+    ASSERT(*ppCm, 1);
+    
+    // Clean every variable
+    memset(*ppCm, 0, sizeof(collMap));
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Free a collision map's memory
+ */
+void cm_free(collMap **ppCm) {
+    // Check params
+    ASSERT_NR(ppCm);
+    ASSERT_NR(*ppCm);
+    
+    if ((*ppCm)->pFlags)
+        free((*ppCm)->pFlags);
+    if ((*ppCm)->pExact)
+        free((*ppCm)->pExact);
+    if ((*ppCm)->pTileNodes)
+        free((*ppCm)->pTileNodes);
+    if ((*ppCm)->pAreas)
+        free((*ppCm)->pAreas);
+    if ((*ppCm)->pNodes)
+        free((*ppCm)->pNodes);
+    if ((*ppCm)->pRects)
+        free((*ppCm)->pRects);
+    if ((*ppCm)->pRuns)
+        free((*ppCm)->pRuns);
+    if ((*ppCm)->ppHits)
+        free((*ppCm)->ppHits);
+    
+    // Free the map
+    free(*ppCm);
+    *ppCm = 0;
+    
+__ret:
+    return;
+}
+
+/**
+ * Set the map's dimensions, in tiles, and clear every tile
+ */
+int cm_init(collMap *pCm, int width, int height) {
+    int i, rv;
+    
+    // Check the arguments
+    ASSERT(pCm, 1);
+    ASSERT(width > 0, 1);
+    ASSERT(height > 0, 1);
+    
+    // Expand the flags, if needed
+    if (width * height > pCm->flagsLen) {
+        // Nothing is valid until every buffer is expanded
+        pCm->flagsLen = 0;
+        pCm->width = 0;
+        pCm->height = 0;
+        pCm->pFlags = (unsigned char*)realloc(pCm->pFlags, width * height);
+        ASSERT(pCm->pFlags, 1);
+        pCm->pExact = (unsigned char*)realloc(pCm->pExact, width * height);
+        ASSERT(pCm->pExact, 1);
+        pCm->pTileNodes = (int*)realloc(pCm->pTileNodes,
+                sizeof(int) * width * height);
+        ASSERT(pCm->pTileNodes, 1);
+        pCm->flagsLen = width * height;
+    }
+    memset(pCm->pFlags, 0x0, width * height);
+    memset(pCm->pExact, 0x0, width * height);
+    pCm->width = width;
+    pCm->height = height;
+    i = 0;
+    while (i < width * height) {
+        pCm->pTileNodes[i] = -1;
+        i++;
+    }
+    pCm->areasUsed = 0;
+    pCm->nodesUsed = 0;
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Add flags to every tile that a box overlaps, and mark them as exact (i.e.,
+ * as covering the whole tile) if requested
+ */
+static void cm_flagTiles(collMap *pCm, int x, int y, int w, int h, int flags,
+        int isExact) {
+    int iniX, iniY, endX, endY, tx, ty;
+    
+    if (!cm_getTiles(&iniX, &iniY, &endX, &endY, pCm, x, y, w, h))
+        return;
+    
+    ty = iniY;
+    while (ty < endY) {
+        unsigned char *pRow, *pExact;
+        
+        pRow = pCm->pFlags + ty * pCm->width;
+        pExact = pCm->pExact + ty * pCm->width;
+        tx = iniX;
+        while (tx < endX) {
+            pRow[tx] |= (unsigned char)flags;
+            if (isExact)
+                pExact[tx] |= (unsigned char)flags;
+            tx++;
+        }
+        ty++;
+    }
+}
+
+/**
+ * Add flags to every tile that a box (in pixels) overlaps; Tiles outside the
+ * map are ignored
+ */
+void cm_setRect(collMap *pCm, int x, int y, int w, int h, int flags) {
+    cm_flagTiles(pCm, x, y, w, h, flags, 1/*isExact*/);
+}
+
+/**
+ * Add flags to an area (in pixels) that may not be aligned to the tiles
+ */
+int cm_addArea(collMap *pCm, int x, int y, int w, int h, int flags) {
+    cmArea *pArea;
+    int i, iniX, iniY, endX, endY, node, rv, tx, ty;
+    
+    // Check the arguments
+    ASSERT(pCm, 1);
+    ASSERT(w > 0 && h > 0, 1);
+    
+    // An area outside the map could never be overlapped
+    if (!cm_getTiles(&iniX, &iniY, &endX, &endY, pCm, x, y, w, h))
+        return 0;
+    cm_flagTiles(pCm, x, y, w, h, flags, 0/*isExact*/);
+    
+    // The same area would be on the list of its first tile
+    node = pCm->pTileNodes[iniX + iniY * pCm->width];
+    while (node != -1) {
+        pArea = &pCm->pAreas[pCm->pNodes[node].area];
+        if (pArea->x == x && pArea->y == y && pArea->w == w && pArea->h == h) {
+            pArea->flags |= flags;
+            return 0;
+        }
+        node = pCm->pNodes[node].next;
+    }
+    
+    // Expand the areas and the nodes, if needed
+    if (pCm->areasUsed >= pCm->areasLen) {
+        pCm->areasLen += 8;
+        pCm->pAreas = (cmArea*)realloc(pCm->pAreas,
+                sizeof(cmArea) * pCm->areasLen);
+        ASSERT(pCm->pAreas, 1);
+    }
+    i = (endX - iniX) * (endY - iniY);
+    if (pCm->nodesUsed + i > pCm->nodesLen) {
+        pCm->nodesLen = (pCm->nodesUsed + i) * 2;
+        pCm->pNodes = (cmNode*)realloc(pCm->pNodes,
+                sizeof(cmNode) * pCm->nodesLen);
+        ASSERT(pCm->pNodes, 1);
+    }
+    
+    i = pCm->areasUsed;
+    pArea = &pCm->pAreas[i];
+    pArea->x = x;
+    pArea->y = y;
+    pArea->w = w;
+    pArea->h = h;
+    pArea->flags = flags;
+    pCm->areasUsed++;
+    
+    // Push it into every tile's list
+    ty = iniY;
+    while (ty < endY) {
+        tx = iniX;
+        while (tx < endX) {
+            int *pHead;
+            
+            pHead = &pCm->pTileNodes[tx + ty * pCm->width];
+            pCm->pNodes[pCm->nodesUsed].area = i;
+            pCm->pNodes[pCm->nodesUsed].next = *pHead;
+            *pHead = pCm->nodesUsed;
+            pCm->nodesUsed++;
+            tx++;
+        }
+        ty++;
+    }
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Returns whether a box overlaps anything with any of the flags
+ */
+int cm_overlaps(collMap *pCm, int x, int y, int w, int h, int flags) {
+    int iniX, iniY, endX, endY, tx, ty;
+    
+    if (!cm_getTiles(&iniX, &iniY, &endX, &endY, pCm, x, y, w, h))
+        return 0;
+    
+    ty = iniY;
+    while (ty < endY) {
+        unsigned char *pRow, *pExact;
+        int *pNodes;
+        
+        pRow = pCm->pFlags + ty * pCm->width;
+        pExact = pCm->pExact + ty * pCm->width;
+        pNodes = pCm->pTileNodes + ty * pCm->width;
+        tx = iniX;
+        while (tx < endX) {
+            int node;
+            
+            // A flag set directly covers the whole tile
+            if (pExact[tx] & flags)
+                return 1;
+            
+            // Otherwise, it came from areas, which must be tested exactly
+            node = -1;
+            if (pRow[tx] & flags)
+                node = pNodes[tx];
+            while (node != -1) {
+                cmArea *pArea;
+                
+                pArea = &pCm->pAreas[pCm->pNodes[node].area];
+                if ((pArea->flags & flags) && x < pArea->x + pArea->w &&
+                        pArea->x < x + w && y < pArea->y + pArea->h &&
+                        pArea->y < y + h)
+                    return 1;
+                node = pCm->pNodes[node].next;
+            }
+            tx++;
+        }
+        ty++;
+    }
+    
+    return 0;
+}
+
+/**
+ * Check whether every tile on a row, in [ini, end), is solid
+ */
+static int cm_isRowSolid(collMap *pCm, int ty, int ini, int end) {
+    unsigned char *pRow;
+    
+    pRow = pCm->pFlags + ty * pCm->width;
+    while (ini < end) {
+        if (!(pRow[ini] & CM_SOLID))
+            return 0;
+        ini++;
+    }
+    return 1;
+}
+
+/**
+ * Retrieve the solid tiles that a box overlaps, merged into rectangles; The
+ * list is only valid until the next query
+ */
+int cm_getSolids(GFraMe_object ***pppRuns, int *pLen, collMap *pCm, int x,
+        int y, int w, int h) {
+    int i, iniX, iniY, endX, endY, len, maxLen, rv, tx, ty;
+    
+    *pppRuns = pCm->ppHits;
+    *pLen = 0;
+    if (!cm_getTiles(&iniX, &iniY, &endX, &endY, pCm, x, y, w, h))
+        return 0;
+    
+    // Each row has, at most, a run on every other tile
+    maxLen = (endY - iniY) * ((endX - iniX + 1) / 2);
+    if (maxLen > pCm->runsLen) {
+        // Nothing is valid until every buffer is expanded
+        pCm->runsLen = 0;
+        pCm->pRects = (cmRect*)realloc(pCm->pRects, sizeof(cmRect) * maxLen);
+        ASSERT(pCm->pRects, 1);
+        pCm->pRuns = (GFraMe_object*)realloc(pCm->pRuns,
+                sizeof(GFraMe_object) * maxLen);
+        ASSERT(pCm->pRuns, 1);
+        pCm->ppHits = (GFraMe_object**)realloc(pCm->ppHits,
+                sizeof(GFraMe_object*) * maxLen);
+        ASSERT(pCm->ppHits, 1);
+        pCm->runsLen = maxLen;
+    }
+    
+    // Find every horizontal run, sorted by row and then column
+    len = 0;
+    ty = iniY;
+    while (ty < endY) {
+        unsigned char *pRow;
+        
+        pRow = pCm->pFlags + ty * pCm->width;
+        tx = iniX;
+        while (tx < endX) {
+            int ini;
+            
+            if (!(pRow[tx] & CM_SOLID)) {
+                tx++;
+                continue;
+            }
+            
+            // Extend the run a tile past the box (if it's that long), so its
+            // ends are never mistaken for a wall's side
+            ini = tx;
+            if (ini == iniX && ini > 0 && (pRow[ini - 1] & CM_SOLID))
+                ini--;
+            while (tx < endX && (pRow[tx] & CM_SOLID))
+                tx++;
+            if (tx == endX && tx < pCm->width && (pRow[tx] & CM_SOLID))
+                tx++;
+            
+            pCm->pRects[len].x = ini;
+            pCm->pRects[len].y = ty;
+            pCm->pRects[len].w = tx - ini;
+            pCm->pRects[len].h = 1;
+            len++;
+        }
+        ty++;
+    }
+    
+    // Merge every run into the same run on the rows below it, so walls don't
+    // have seams between their rows either
+    i = 0;
+    while (i < len) {
+        cmRect *pRect;
+        int j;
+        
+        pRect = &pCm->pRects[i];
+        j = i + 1;
+        while (pRect->h > 0 && j < len) {
+            cmRect *pNext;
+            
+            pNext = &pCm->pRects[j];
+            j++;
+            if (pNext->y < pRect->y + pRect->h || (pNext->y ==
+                    pRect->y + pRect->h && pNext->x < pRect->x))
+                continue;
+            if (pNext->y > pRect->y + pRect->h || pNext->x > pRect->x)
+                break;
+            if (pNext->w == pRect->w) {
+                pRect->h++;
+                pNext->h = 0;
+            }
+        }
+        i++;
+    }
+    
+    // Extend the rectangles a tile past the box, as was done with the runs
+    *pLen = 0;
+    i = 0;
+    while (i < len) {
+        GFraMe_object *pRun;
+        cmRect *pRect;
+        
+        pRect = &pCm->pRects[i];
+        i++;
+        if (pRect->h == 0)
+            continue;
+        
+        if (pRect->y == iniY && iniY > 0 && cm_isRowSolid(pCm, iniY - 1,
+                pRect->x, pRect->x + pRect->w)) {
+            pRect->y--;
+            pRect->h++;
+        }
+        if (pRect->y + pRect->h == endY && endY < pCm->height &&
+                cm_isRowSolid(pCm, endY, pRect->x, pRect->x + pRect->w))
+            pRect->h++;
+        
+        pRun = &pCm->pRuns[*pLen];
+        GFraMe_object_clear(pRun);
+        GFraMe_object_set_x(pRun, pRect->x * 8);
+        GFraMe_object_set_y(pRun, pRect->y * 8);
+        GFraMe_hitbox_set(&pRun->hitbox, GFraMe_hitbox_upper_left,
+                0/*x*/, 0/*y*/, pRect->w * 8, pRect->h * 8);
+        pCm->ppHits[*pLen] = pRun;
+        (*pLen)++;
+    }
+    
+    *pppRuns = pCm->ppHits;
+    rv = 0;
+__ret:
+    return rv;
+}
+
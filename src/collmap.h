@@ -0,0 +1,71 @@
+/**
+ * @file src/collmap.h
+ *
+ * Per-tile collision flags (solid, hazard and checkpoint), so checking a box
+ * against the world only looks up the tiles under it, no matter how many walls
+ * or spikes the map has
+ *
+ * Solids are aligned to the tiles; Other flags may be added as areas, which
+ * only apply inside their exact bounds (their tiles are only a broadphase)
+ */
+#ifndef __COLLMAP_H__
+#define __COLLMAP_H__
+
+#include <GFraMe/GFraMe_object.h>
+
+/** 'Export' the collision map structure */
+typedef struct stCollMap collMap;
+
+/** What a tile does to whatever touches it */
+typedef enum {
+    CM_SOLID      = 0x01,
+    CM_HAZARD     = 0x02,
+    CM_CHECKPOINT = 0x04
+} cmFlag;
+
+/**
+ * Alloc a new collision map
+ */
+int cm_getNew(collMap **ppCm);
+
+/**
+ * Free a collision map's memory
+ */
+void cm_free(collMap **ppCm);
+
+/**
+ * Set the map's dimensions, in tiles, and clear every tile
+ */
+int cm_init(collMap *pCm, int width, int height);
+
+/**
+ * Add flags to every tile that a box (in pixels) overlaps; Tiles outside the
+ * map are ignored
+ */
+void cm_setRect(collMap *pCm, int x, int y, int w, int h, int flags);
+
+/**
+ * Add flags to an area (in pixels) that may not be aligned to the tiles; Its
+ * tiles are flagged, but a box must overlap the area itself to be affected by
+ * it; Adding the same area again only adds its flags
+ */
+int cm_addArea(collMap *pCm, int x, int y, int w, int h, int flags);
+
+/**
+ * Returns whether a box overlaps anything with any of the flags: either a tile
+ * set through cm_setRect or an area added through cm_addArea
+ */
+int cm_overlaps(collMap *pCm, int x, int y, int w, int h, int flags);
+
+/**
+ * Retrieve the solid tiles that a box overlaps, merged into rectangles (so
+ * nothing may snag on the seam between two tiles); The list is only valid
+ * until the next query
+ *
+ * @return 0 on success
+ */
+int cm_getSolids(GFraMe_object ***pppRuns, int *pLen, collMap *pCm, int x,
+        int y, int w, int h);
+
+#endif /* __COLLMAP_H__ */
+
@@ -0,0 +1,545 @@
+/**
+ * @file src/draw.c
+ *
+ * Deferred draw list; Every draw is queued and only issued (sorted by layer,
+ * order and texture) on drw_flush
+ *
+ * If compiled with DIRTY_RECTS, the frame is rendered into a retained target
+ * and every command is compared against the previous frame's; Only the
+ * rectangles covered by commands that appeared, disappeared or changed are
+ * cleared and redrawn, and the target is then copied to the screen
+ */
+#include <GFraMe/GFraMe_sprite.h>
+#include <GFraMe/GFraMe_spriteset.h>
+#include <GFraMe/GFraMe_texture.h>
+#if defined(DIRTY_RECTS)
+#  include <GFraMe/GFraMe_screen.h>
+#  include <SDL2/SDL_render.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "draw.h"
+#include "global.h"
+
+/** A single queued draw */
+struct stDrawCmd {
+    /** Layer where it's rendered */
+    drwLayer layer;
+    /** Order within the layer, for things that must not be batched together */
+    int order;
+    /** Texture used (only to group commands) */
+    GFraMe_texture *pTex;
+    /** Order in which it was queued, to keep the sort stable */
+    int seq;
+    /** Spriteset for tile commands */
+    GFraMe_spriteset *pSset;
+    /** Sprite for sprite commands */
+    GFraMe_sprite *pSpr;
+    /** Tile to be rendered */
+    int tile;
+    /** Tile's position or camera's position */
+    int x;
+    /** Tile's position or camera's position */
+    int y;
+    /** Camera's dimensions (for sprites) */
+    int w;
+    /** Camera's dimensions (for sprites) */
+    int h;
+    /** Whether the tile is flipped */
+    int flipped;
+};
+typedef struct stDrawCmd drawCmd;
+
+/** Every command queued on this frame */
+static drawCmd *_drwCmds = 0;
+/** How many commands were queued */
+static int _drwCmdsUsed = 0;
+/** How many commands there are allocated */
+static int _drwCmdsLen = 0;
+
+#if defined(DIRTY_RECTS)
+/** Everything that affects what a command renders */
+struct stDrawKey {
+    /** Layer where it's rendered */
+    drwLayer layer;
+    /** Order within the layer */
+    int order;
+    /** The spriteset or the sprite */
+    void *pSrc;
+    /** Tile (or sprite frame) rendered */
+    int tile;
+    /** Whether the tile is flipped */
+    int flipped;
+    /** Rectangle covered on the screen */
+    SDL_Rect rect;
+};
+typedef struct stDrawKey drawKey;
+
+/** Keys of the frame being rendered and of the previous one */
+static drawKey *_drwKeys = 0;
+static drawKey *_drwPrevKeys = 0;
+/** How many keys there are on the previous frame */
+static int _drwPrevKeysUsed = 0;
+/** How many keys there are allocated (on each list) */
+static int _drwKeysLen = 0;
+/** Areas that must be redrawn on this frame */
+static SDL_Rect _drwDirty[DRW_MAX_DIRTY_RECTS];
+/** How many areas there are to be redrawn */
+static int _drwDirtyUsed = 0;
+/** Render target retained between frames */
+static SDL_Texture *_drwTarget = 0;
+/** Whether the target holds the previous frame */
+static int _drwIsValid = 0;
+#endif
+
+/**
+ * Get a new command from the list, expanding it as needed
+ */
+static drawCmd* drw_getCmd(drwLayer layer, int order, GFraMe_texture *pTex) {
+    drawCmd *pCmd;
+    
+    if (_drwCmdsUsed >= _drwCmdsLen) {
+        drawCmd *pTmp;
+        int len;
+        
+        len = _drwCmdsLen * 2;
+        if (len == 0)
+            len = 256;
+        pTmp = (drawCmd*)realloc(_drwCmds, sizeof(drawCmd) * len);
+        if (!pTmp)
+            return 0;
+        _drwCmds = pTmp;
+        _drwCmdsLen = len;
+    }
+    
+    pCmd = &_drwCmds[_drwCmdsUsed];
+    memset(pCmd, 0x0, sizeof(drawCmd));
+    pCmd->layer = layer;
+    pCmd->order = order;
+    pCmd->pTex = pTex;
+    pCmd->seq = _drwCmdsUsed;
+    _drwCmdsUsed++;
+    
+    return pCmd;
+}
+
+/**
+ * Sort the commands by layer, then order, then texture, then queue order
+ */
+static int drw_compare(const void *pA, const void *pB) {
+    const drawCmd *pCmdA, *pCmdB;
+    
+    pCmdA = (const drawCmd*)pA;
+    pCmdB = (const drawCmd*)pB;
+    
+    if (pCmdA->layer != pCmdB->layer)
+        return pCmdA->layer - pCmdB->layer;
+    if (pCmdA->order != pCmdB->order)
+        return pCmdA->order - pCmdB->order;
+    if (pCmdA->pTex != pCmdB->pTex)
+        return ((char*)pCmdA->pTex < (char*)pCmdB->pTex) ? -1 : 1;
+    return pCmdA->seq - pCmdB->seq;
+}
+
+/**
+ * Queue a tile from a spriteset
+ */
+void drw_tile(GFraMe_spriteset *pSset, GFraMe_texture *pTex, int tile, int x,
+        int y, int flipped, drwLayer layer) {
+    drw_orderedTile(pSset, pTex, tile, x, y, flipped, layer, 0/*order*/);
+}
+
+/**
+ * Queue a tile on a given order within its layer
+ */
+void drw_orderedTile(GFraMe_spriteset *pSset, GFraMe_texture *pTex, int tile,
+        int x, int y, int flipped, drwLayer layer, int order) {
+    drawCmd *pCmd;
+    
+    pCmd = drw_getCmd(layer, order, pTex);
+    if (!pCmd)
+        return;
+    
+    pCmd->pSset = pSset;
+    pCmd->tile = tile;
+    pCmd->x = x;
+    pCmd->y = y;
+    pCmd->flipped = flipped;
+}
+
+/**
+ * Queue a sprite, rendered relative to a camera
+ */
+void drw_sprite(GFraMe_sprite *pSpr, GFraMe_texture *pTex, int camX, int camY,
+        int camW, int camH, drwLayer layer) {
+    drawCmd *pCmd;
+    
+    pCmd = drw_getCmd(layer, 0/*order*/, pTex);
+    if (!pCmd)
+        return;
+    
+    pCmd->pSpr = pSpr;
+    pCmd->x = camX;
+    pCmd->y = camY;
+    pCmd->w = camW;
+    pCmd->h = camH;
+}
+
+/**
+ * Issue a single command
+ */
+static void drw_issue(drawCmd *pCmd) {
+    if (pCmd->pSpr)
+        GFraMe_sprite_draw_camera(pCmd->pSpr, pCmd->x, pCmd->y, pCmd->w,
+                pCmd->h);
+    else
+        GFraMe_spriteset_draw(pCmd->pSset, pCmd->tile, pCmd->x, pCmd->y,
+                pCmd->flipped);
+}
+
+#if defined(DIRTY_RECTS)
+/**
+ * Fill a command's key
+ */
+static void drw_getKey(drawKey *pKey, drawCmd *pCmd) {
+    memset(pKey, 0x0, sizeof(drawKey));
+    pKey->layer = pCmd->layer;
+    pKey->order = pCmd->order;
+    if (pCmd->pSpr) {
+        GFraMe_sprite *pSpr;
+        
+        pSpr = pCmd->pSpr;
+        pKey->pSrc = pSpr;
+        pKey->tile = pSpr->cur_tile;
+        pKey->flipped = pSpr->flipped;
+        pKey->rect.x = pSpr->obj.x + pSpr->offset_x - pCmd->x;
+        pKey->rect.y = pSpr->obj.y + pSpr->offset_y - pCmd->y;
+        pKey->rect.w = pSpr->sset->tw;
+        pKey->rect.h = pSpr->sset->th;
+    }
+    else {
+        pKey->pSrc = pCmd->pSset;
+        pKey->tile = pCmd->tile;
+        pKey->flipped = pCmd->flipped;
+        pKey->rect.x = pCmd->x;
+        pKey->rect.y = pCmd->y;
+        pKey->rect.w = pCmd->pSset->tw;
+        pKey->rect.h = pCmd->pSset->th;
+    }
+}
+
+/**
+ * Sort the keys by every field, so two frames may be merged
+ */
+static int drw_compareKeys(const void *pA, const void *pB) {
+    const drawKey *pKeyA, *pKeyB;
+    
+    pKeyA = (const drawKey*)pA;
+    pKeyB = (const drawKey*)pB;
+    
+    if (pKeyA->layer != pKeyB->layer)
+        return pKeyA->layer - pKeyB->layer;
+    if (pKeyA->order != pKeyB->order)
+        return pKeyA->order - pKeyB->order;
+    if (pKeyA->pSrc != pKeyB->pSrc)
+        return ((char*)pKeyA->pSrc < (char*)pKeyB->pSrc) ? -1 : 1;
+    if (pKeyA->tile != pKeyB->tile)
+        return pKeyA->tile - pKeyB->tile;
+    if (pKeyA->flipped != pKeyB->flipped)
+        return pKeyA->flipped - pKeyB->flipped;
+    if (pKeyA->rect.x != pKeyB->rect.x)
+        return pKeyA->rect.x - pKeyB->rect.x;
+    if (pKeyA->rect.y != pKeyB->rect.y)
+        return pKeyA->rect.y - pKeyB->rect.y;
+    if (pKeyA->rect.w != pKeyB->rect.w)
+        return pKeyA->rect.w - pKeyB->rect.w;
+    return pKeyA->rect.h - pKeyB->rect.h;
+}
+
+/**
+ * Check whether two rectangles overlap
+ */
+static int drw_intersects(const SDL_Rect *pA, const SDL_Rect *pB) {
+    return pA->x < pB->x + pB->w && pB->x < pA->x + pA->w &&
+            pA->y < pB->y + pB->h && pB->y < pA->y + pA->h;
+}
+
+/**
+ * Extend a rectangle so it also covers another one
+ */
+static void drw_merge(SDL_Rect *pDst, const SDL_Rect *pSrc) {
+    int x1, y1, x2, y2;
+    
+    x1 = pDst->x < pSrc->x ? pDst->x : pSrc->x;
+    y1 = pDst->y < pSrc->y ? pDst->y : pSrc->y;
+    x2 = pDst->x + pDst->w;
+    if (pSrc->x + pSrc->w > x2)
+        x2 = pSrc->x + pSrc->w;
+    y2 = pDst->y + pDst->h;
+    if (pSrc->y + pSrc->h > y2)
+        y2 = pSrc->y + pSrc->h;
+    
+    pDst->x = x1;
+    pDst->y = y1;
+    pDst->w = x2 - x1;
+    pDst->h = y2 - y1;
+}
+
+/**
+ * Mark an area of the screen to be redrawn; Areas that overlap are merged,
+ * and once the list is full everything else is merged into its last area
+ */
+static void drw_addDirty(const SDL_Rect *pRect) {
+    SDL_Rect rect;
+    int i;
+    
+    // Clip it to the screen
+    rect = *pRect;
+    if (rect.x < 0) {
+        rect.w += rect.x;
+        rect.x = 0;
+    }
+    if (rect.y < 0) {
+        rect.h += rect.y;
+        rect.y = 0;
+    }
+    if (rect.x + rect.w > SCRW)
+        rect.w = SCRW - rect.x;
+    if (rect.y + rect.h > SCRH)
+        rect.h = SCRH - rect.y;
+    if (rect.w <= 0 || rect.h <= 0)
+        return;
+    
+    i = 0;
+    while (i < _drwDirtyUsed) {
+        if (drw_intersects(&_drwDirty[i], &rect)) {
+            drw_merge(&_drwDirty[i], &rect);
+            return;
+        }
+        i++;
+    }
+    
+    if (_drwDirtyUsed < DRW_MAX_DIRTY_RECTS) {
+        _drwDirty[_drwDirtyUsed] = rect;
+        _drwDirtyUsed++;
+    }
+    else
+        drw_merge(&_drwDirty[DRW_MAX_DIRTY_RECTS - 1], &rect);
+}
+
+/**
+ * Compare the current frame against the previous one and list every area
+ * that changed; Returns 0 if the keys couldn't be stored (and so the frame
+ * should be issued as usual)
+ */
+static int drw_findDirty() {
+    int i, j;
+    
+    if (_drwKeysLen < _drwCmdsUsed) {
+        drawKey *pTmp;
+        
+        pTmp = (drawKey*)realloc(_drwKeys, sizeof(drawKey) * _drwCmdsLen);
+        if (!pTmp)
+            return 0;
+        _drwKeys = pTmp;
+        pTmp = (drawKey*)realloc(_drwPrevKeys, sizeof(drawKey) * _drwCmdsLen);
+        if (!pTmp)
+            return 0;
+        _drwPrevKeys = pTmp;
+        _drwKeysLen = _drwCmdsLen;
+    }
+    
+    i = 0;
+    while (i < _drwCmdsUsed) {
+        drw_getKey(&_drwKeys[i], &_drwCmds[i]);
+        i++;
+    }
+    qsort(_drwKeys, _drwCmdsUsed, sizeof(drawKey), drw_compareKeys);
+    
+    _drwDirtyUsed = 0;
+    if (!_drwIsValid) {
+        SDL_Rect rect;
+        
+        rect.x = 0;
+        rect.y = 0;
+        rect.w = SCRW;
+        rect.h = SCRH;
+        drw_addDirty(&rect);
+    }
+    else {
+        // Walk both sorted lists; Any key found on a single one is either
+        // where something was or where something now is
+        i = 0;
+        j = 0;
+        while (i < _drwCmdsUsed || j < _drwPrevKeysUsed) {
+            int cmp;
+            
+            if (i >= _drwCmdsUsed)
+                cmp = 1;
+            else if (j >= _drwPrevKeysUsed)
+                cmp = -1;
+            else
+                cmp = drw_compareKeys(&_drwKeys[i], &_drwPrevKeys[j]);
+            
+            if (cmp < 0) {
+                drw_addDirty(&_drwKeys[i].rect);
+                i++;
+            }
+            else if (cmp > 0) {
+                drw_addDirty(&_drwPrevKeys[j].rect);
+                j++;
+            }
+            else {
+                i++;
+                j++;
+            }
+        }
+    }
+    
+    return 1;
+}
+
+/**
+ * Store the current frame's keys as the previous frame
+ */
+static void drw_swapKeys() {
+    drawKey *pTmp;
+    
+    pTmp = _drwPrevKeys;
+    _drwPrevKeys = _drwKeys;
+    _drwKeys = pTmp;
+    _drwPrevKeysUsed = _drwCmdsUsed;
+}
+
+/**
+ * Redraw every dirty area into the retained target and copy it to the
+ * screen; Returns 0 if there's no target to be used
+ */
+static int drw_flushDirty() {
+    SDL_Texture *pScreen;
+    Uint8 r, g, b, a;
+    int i;
+    
+    if (!_drwTarget) {
+        _drwTarget = SDL_CreateTexture(GFraMe_renderer,
+                SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, SCRW,
+                SCRH);
+        if (!_drwTarget)
+            return 0;
+        SDL_SetTextureBlendMode(_drwTarget, SDL_BLENDMODE_NONE);
+        _drwIsValid = 0;
+    }
+    if (!drw_findDirty()) {
+        _drwIsValid = 0;
+        return 0;
+    }
+    
+    pScreen = SDL_GetRenderTarget(GFraMe_renderer);
+    if (_drwDirtyUsed > 0 &&
+            SDL_SetRenderTarget(GFraMe_renderer, _drwTarget) == 0) {
+        SDL_GetRenderDrawColor(GFraMe_renderer, &r, &g, &b, &a);
+        SDL_SetRenderDrawColor(GFraMe_renderer, 0, 0, 0, 0xff);
+        
+        i = 0;
+        while (i < _drwDirtyUsed) {
+            SDL_Rect *pRect;
+            int j;
+            
+            pRect = &_drwDirty[i];
+            SDL_RenderSetClipRect(GFraMe_renderer, pRect);
+            SDL_RenderFillRect(GFraMe_renderer, pRect);
+            
+            // The keys are sorted differently, so get each rectangle again
+            j = 0;
+            while (j < _drwCmdsUsed) {
+                drawKey key;
+                
+                drw_getKey(&key, &_drwCmds[j]);
+                if (drw_intersects(&key.rect, pRect))
+                    drw_issue(&_drwCmds[j]);
+                j++;
+            }
+            i++;
+        }
+        
+        SDL_RenderSetClipRect(GFraMe_renderer, 0);
+        SDL_SetRenderDrawColor(GFraMe_renderer, r, g, b, a);
+        SDL_SetRenderTarget(GFraMe_renderer, pScreen);
+        _drwIsValid = 1;
+    }
+    else if (_drwDirtyUsed > 0) {
+        _drwIsValid = 0;
+        return 0;
+    }
+    drw_swapKeys();
+    
+    // The screen itself isn't assumed to be kept between frames
+    SDL_RenderCopy(GFraMe_renderer, _drwTarget, 0, 0);
+    return 1;
+}
+#endif
+
+/**
+ * Sort every queued command and issue them; The list is emptied afterward
+ */
+void drw_flush() {
+    int i;
+    
+    if (_drwCmdsUsed == 0)
+        return;
+    
+    qsort(_drwCmds, _drwCmdsUsed, sizeof(drawCmd), drw_compare);
+    
+#if defined(DIRTY_RECTS)
+    if (drw_flushDirty()) {
+        _drwCmdsUsed = 0;
+        return;
+    }
+#endif
+    
+    i = 0;
+    while (i < _drwCmdsUsed) {
+        drw_issue(&_drwCmds[i]);
+        i++;
+    }
+    
+    _drwCmdsUsed = 0;
+}
+
+/**
+ * Force the next frame to be fully redrawn (e.g., because a new map was
+ * loaded or the render target was lost); Does nothing without DIRTY_RECTS
+ */
+void drw_invalidate() {
+#if defined(DIRTY_RECTS)
+    _drwIsValid = 0;
+#endif
+}
+
+/**
+ * Release the list's memory
+ */
+void drw_clean() {
+    if (_drwCmds)
+        free(_drwCmds);
+    _drwCmds = 0;
+    _drwCmdsUsed = 0;
+    _drwCmdsLen = 0;
+#if defined(DIRTY_RECTS)
+    if (_drwKeys)
+        free(_drwKeys);
+    if (_drwPrevKeys)
+        free(_drwPrevKeys);
+    _drwKeys = 0;
+    _drwPrevKeys = 0;
+    _drwPrevKeysUsed = 0;
+    _drwKeysLen = 0;
+    if (_drwTarget)
+        SDL_DestroyTexture(_drwTarget);
+    _drwTarget = 0;
+    _drwIsValid = 0;
+#endif
+}
+
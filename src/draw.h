@@ -0,0 +1,72 @@
+/**
+ * @file src/draw.h
+ *
+ * Deferred draw list; Every draw is queued and only issued (sorted by layer,
+ * order and texture) on drw_flush
+ */
+#ifndef __DRAW_H__
+#define __DRAW_H__
+
+#include <GFraMe/GFraMe_sprite.h>
+#include <GFraMe/GFraMe_spriteset.h>
+#include <GFraMe/GFraMe_texture.h>
+
+/** How many background/foreground tilemaps may be queued on their own layers */
+#define DRW_MAX_BG_LAYERS 4
+#define DRW_MAX_FG_LAYERS 4
+
+/** Layers, from the back to the front */
+typedef enum {
+    DRW_LAYER_BG = 0,
+    DRW_LAYER_MAP = DRW_LAYER_BG + DRW_MAX_BG_LAYERS,
+    DRW_LAYER_SPRITES,
+    DRW_LAYER_FG,
+    DRW_LAYER_UI = DRW_LAYER_FG + DRW_MAX_FG_LAYERS,
+    DRW_LAYER_TEXT_BG,
+    DRW_LAYER_TEXT,
+    DRW_LAYER_MAX
+} drwLayer;
+
+/**
+ * Queue a tile from a spriteset
+ */
+void drw_tile(GFraMe_spriteset *pSset, GFraMe_texture *pTex, int tile, int x,
+        int y, int flipped, drwLayer layer);
+
+/**
+ * Queue a tile on a given order within its layer; Commands with a lower order
+ * are issued first, regardless of their texture (drw_tile uses order 0)
+ */
+void drw_orderedTile(GFraMe_spriteset *pSset, GFraMe_texture *pTex, int tile,
+        int x, int y, int flipped, drwLayer layer, int order);
+
+/**
+ * Queue a sprite, rendered relative to a camera
+ */
+void drw_sprite(GFraMe_sprite *pSpr, GFraMe_texture *pTex, int camX, int camY,
+        int camW, int camH, drwLayer layer);
+
+/**
+ * Sort every queued command and issue them; The list is emptied afterward
+ *
+ * If compiled with DIRTY_RECTS, the frame is kept on a render target and only
+ * the areas that changed since the previous frame are redrawn; Sprites are
+ * compared by their position, frame and flip, so anything else that changes
+ * how they look (or two overlapping commands that only swap their order)
+ * requires a call to drw_invalidate
+ */
+void drw_flush();
+
+/**
+ * Force the next frame to be fully redrawn (e.g., because a new map was
+ * loaded or the render target was lost)
+ */
+void drw_invalidate();
+
+/**
+ * Release the list's memory
+ */
+void drw_clean();
+
+#endif /* __DRAW_H__ */
+
@@ -2,28 +2,47 @@
  * @file src/global.c
  */
 #include <GFraMe/GFraMe_assets.h>
-#include <GFraMe/GFraMe_audio.h>
 #include <GFraMe/GFraMe_error.h>
 #include <GFraMe/GFraMe_spriteset.h>
 #include <GFraMe/GFraMe_texture.h>
 
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_cpuinfo.h>
+#include <SDL2/SDL_filesystem.h>
+#include <SDL2/SDL_stdinc.h>
+#include <SDL2/SDL_thread.h>
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "global.h"
+#include "mixer.h"
+#include "music.h"
+#include "pack.h"
+#include "texcache.h"
 
 int gl_running = 0;
 static int is_init = 0;
 
+unsigned char *gl_atlasData = 0;
+/** Where gl_atlasData came from (and, so, how it must be released) */
+static enum {
+    GL_ATLAS_DECODED = 0,
+    GL_ATLAS_CACHED,
+    GL_ATLAS_PACKED
+} _glAtlasSrc = GL_ATLAS_DECODED;
+
 #define DECLARE_SSET(W, H) \
   GFraMe_spriteset *gl_sset##W##x##H; \
   static GFraMe_spriteset _glSset##W##x##H
 
 #define DECLARE_AUDIO(AUD) \
-  static GFraMe_audio  _glAud_##AUD; \
-  GFraMe_audio * gl_aud_##AUD
+  static mixClip _glAud_##AUD; \
+  mixClip * gl_aud_##AUD
 
-static GFraMe_texture gl_tex;
+static GFraMe_texture _glTex;
+GFraMe_texture *gl_tex = &_glTex;
 DECLARE_SSET(2, 2);
 DECLARE_SSET(4, 4);
 DECLARE_SSET(8, 8);
@@ -37,15 +56,157 @@ DECLARE_AUDIO(revive);
 DECLARE_AUDIO(text);
 DECLARE_AUDIO(song1);
 
+/** An asset loaded by the worker pool; Every job must be independent of the
+ * others */
+struct stLoadJob {
+    /** Load the asset (called from any thread) */
+    GFraMe_ret (*load)(struct stLoadJob *pJob);
+    /** Audio to be loaded */
+    mixClip *pAud;
+    /** Where the audio is published, once it's loaded */
+    mixClip **ppAud;
+    /** Audio's file */
+    char *pFilename;
+    /** Song's MML source, synthesized instead of the audio's file if found */
+    char *pMml;
+    /** Whether the audio loops */
+    int doLoop;
+    /** Where the loop starts */
+    int loopPos;
+    /** The job's result */
+    GFraMe_ret rv;
+};
+typedef struct stLoadJob loadJob;
+
+static GFraMe_ret gl_loadAtlas(loadJob *pJob);
+static GFraMe_ret gl_loadAudio(loadJob *pJob);
+static GFraMe_ret gl_loadSong(loadJob *pJob);
+
+/**
+ * Declare jobs for loading audios
+ */
+#define SONG_JOB(AUD, FILEN, MMLN)   {gl_loadSong, &_glAud_##AUD, &gl_aud_##AUD, FILEN, MMLN, 1, 0, GFraMe_ret_ok}
+#define SONG_WINTRO_JOB(AUD, FILEN, MMLN, LOOPPOS)   {gl_loadSong, &_glAud_##AUD, &gl_aud_##AUD, FILEN, MMLN, 1, LOOPPOS,       GFraMe_ret_ok}
+
+/** Every asset loaded on gl_init (the slowest ones first); Sound effects are
+ * only loaded when first played */
+static loadJob _glJobs[] = {
+    {gl_loadAtlas, 0, 0, TEX, 0, 0, 0, GFraMe_ret_ok},
+    SONG_JOB(song1, "song/song1", "mml/song1"),
+};
+/** How many jobs there are */
+#define GL_JOBS_LEN ((int)(sizeof(_glJobs) / sizeof(loadJob)))
+/** Index of the next job to be taken by a worker */
+static SDL_atomic_t _glNextJob;
+
+/**
+ * Load the atlas' pixels; It's uploaded by the main thread, afterward
+ */
+static GFraMe_ret gl_loadAtlas(loadJob *pJob) {
+    GFraMe_ret rv;
+    
+    // Use the packed atlas, if possible; Otherwise, skip decoding the bitmap,
+    // if it was already cached
+    if (pk_getTexture(&gl_atlasData, TEX, TEXW, TEXH) == 0)
+        _glAtlasSrc = GL_ATLAS_PACKED;
+    else if (tc_load(&gl_atlasData, TEX, TEXW, TEXH) == 0)
+        _glAtlasSrc = GL_ATLAS_CACHED;
+    else {
+        _glAtlasSrc = GL_ATLAS_DECODED;
+        rv = GFraMe_assets_buffer_image(TEX, TEXW, TEXH,
+                (char**)&gl_atlasData);
+        ASSERT_NR(rv == GFraMe_ret_ok);
+        
+        tc_save(gl_atlasData, TEX, TEXW, TEXH);
+    }
+    
+    rv = GFraMe_ret_ok;
+__ret:
+    return rv;
+}
+
+/**
+ * Decode an audio and publish it, on success
+ */
+static GFraMe_ret gl_loadAudio(loadJob *pJob) {
+    mix_initClip(pJob->pAud, pJob->pFilename, pJob->doLoop, pJob->loopPos);
+    if (mix_loadClip(pJob->pAud) != 0)
+        return GFraMe_ret_failed;
+    
+    *(pJob->ppAud) = pJob->pAud;
+    return GFraMe_ret_ok;
+}
+
+/**
+ * Synthesize a song from its MML or open it to be streamed; If neither is
+ * possible, fully decode it instead (in which case it's published as any other
+ * audio)
+ */
+static GFraMe_ret gl_loadSong(loadJob *pJob) {
+    if (pJob->pMml && mus_initMml(pJob->pMml, pJob->doLoop) == 0)
+        return GFraMe_ret_ok;
+    if (mus_init(pJob->pFilename, pJob->doLoop, pJob->loopPos) == 0)
+        return GFraMe_ret_ok;
+    return gl_loadAudio(pJob);
+}
+
+/**
+ * Take jobs until every one was started
+ */
+static int gl_loadWorker(void *pArg) {
+    int i;
+    
+    i = SDL_AtomicAdd(&_glNextJob, 1);
+    while (i < GL_JOBS_LEN) {
+        _glJobs[i].rv = _glJobs[i].load(&_glJobs[i]);
+        i = SDL_AtomicAdd(&_glNextJob, 1);
+    }
+    
+    return 0;
+}
+
 GFraMe_ret gl_init() {
+    SDL_Thread *pThreads[GL_MAX_LOADERS];
     GFraMe_ret rv;
-    unsigned char *data = NULL;
+    int i, threadsLen;
 
-    rv = GFraMe_assets_buffer_image(TEX, TEXW, TEXH, (char**)&data);
-    ASSERT_NR(rv == GFraMe_ret_ok);
+    // Map every packed asset at once (if there's no pack, each one is loaded
+    // from its own file)
+    pk_init();
+    
+    // Load every asset on a small pool; The main thread also takes jobs, so
+    // everything still works if no thread could be created
+    SDL_AtomicSet(&_glNextJob, 0);
+    threadsLen = SDL_GetCPUCount() - 1;
+    if (threadsLen > GL_MAX_LOADERS)
+        threadsLen = GL_MAX_LOADERS;
+    i = 0;
+    while (i < threadsLen) {
+        pThreads[i] = SDL_CreateThread(gl_loadWorker, "loader", 0);
+        if (!pThreads[i])
+            break;
+        i++;
+    }
+    threadsLen = i;
+    gl_loadWorker(0);
+    
+    // Wait until every asset is loaded
+    i = 0;
+    while (i < threadsLen) {
+        SDL_WaitThread(pThreads[i], 0);
+        i++;
+    }
+    
+    i = 0;
+    while (i < GL_JOBS_LEN) {
+        rv = _glJobs[i].rv;
+        GFraMe_assertRet(rv == GFraMe_ret_ok, "Loading an asset failed",
+                __ret);
+        i++;
+    }
 
-    GFraMe_texture_init(&gl_tex);
-    rv = GFraMe_texture_load(&gl_tex, TEXW, TEXH, data);
+    GFraMe_texture_init(gl_tex);
+    rv = GFraMe_texture_load(gl_tex, TEXW, TEXH, gl_atlasData);
     ASSERT_NR(rv == GFraMe_ret_ok);
     
     /**
@@ -53,52 +214,93 @@ GFraMe_ret gl_init() {
      */
     #define INIT_SSET(W, H) \
       gl_sset##W##x##H = &_glSset##W##x##H; \
-      GFraMe_spriteset_init(gl_sset##W##x##H, &gl_tex, W, H)
+      GFraMe_spriteset_init(gl_sset##W##x##H, gl_tex, W, H)
     
     INIT_SSET(2, 2);
     INIT_SSET(4, 4);
     INIT_SSET(8, 8);
     INIT_SSET(16, 16);
     
-    #define INIT_AUDIO(AUD, FILEN) \
-      rv = GFraMe_audio_init(&_glAud_##AUD, FILEN, 0, 0, 1); \
-      GFraMe_assertRet(rv == GFraMe_ret_ok, "Loading audio "FILEN" failed", __ret); \
-      gl_aud_##AUD = &_glAud_##AUD
-    #define INIT_SONG(AUD, FILEN) \
-      rv = GFraMe_audio_init(&_glAud_##AUD, FILEN, 1, 0, 1); \
-      GFraMe_assertRet(rv == GFraMe_ret_ok, "Loading audio "FILEN" failed", __ret); \
-      gl_aud_##AUD = &_glAud_##AUD
-    #define INIT_SONG_WINTRO(AUD, FILEN, LOOPPOS) \
-      rv = GFraMe_audio_init(&_glAud_##AUD, FILEN, 1, LOOPPOS, 1); \
-      GFraMe_assertRet(rv == GFraMe_ret_ok, "Loading audio "FILEN" failed", __ret); \
-      gl_aud_##AUD = &_glAud_##AUD
-    #define INIT_SONG_NOLOOP(AUD, FILEN) \
-      rv = GFraMe_audio_init(&_glAud_##AUD, FILEN, 0, 0, 1); \
-      GFraMe_assertRet(rv == GFraMe_ret_ok, "Loading audio "FILEN" failed", __ret); \
-      gl_aud_##AUD = &_glAud_##AUD
-    
-    INIT_AUDIO(step, "sfx/step");
-    INIT_AUDIO(jump, "sfx/jump");
-    INIT_AUDIO(death, "sfx/death");
-    INIT_AUDIO(bullet, "sfx/bullet");
-    INIT_AUDIO(powerup, "sfx/powerup");
-    INIT_AUDIO(revive, "sfx/revive");
-    INIT_AUDIO(text, "sfx/text");
-    INIT_SONG(song1, "song/song1");
+    /**
+     * Reference a sound effect; It's only loaded when first played
+     */
+    #define INIT_SFX(AUD, FILEN) \
+      gl_aud_##AUD = &_glAud_##AUD; \
+      mix_initClip(gl_aud_##AUD, FILEN, 0, 0)
+    
+    INIT_SFX(death, "sfx/death");
+    INIT_SFX(powerup, "sfx/powerup");
+    INIT_SFX(revive, "sfx/revive");
+    INIT_SFX(jump, "sfx/jump");
+    INIT_SFX(step, "sfx/step");
+    INIT_SFX(bullet, "sfx/bullet");
+    INIT_SFX(text, "sfx/text");
     
     gl_running = 1;
     is_init = 1;
     rv = GFraMe_ret_ok;
 __ret:
-    if (data)
-        free(data);
     return rv;
 }
 
 void gl_clean() {
+    // Every clip was already released by mix_clean
     if (is_init) {
-        GFraMe_texture_clear(&gl_tex);
+        GFraMe_texture_clear(gl_tex);
     }
+    if (gl_atlasData && _glAtlasSrc == GL_ATLAS_CACHED)
+        tc_free(&gl_atlasData, TEXW, TEXH);
+    else if (gl_atlasData && _glAtlasSrc == GL_ATLAS_DECODED)
+        free(gl_atlasData);
+    gl_atlasData = 0;
+    mus_clean();
+    pk_clean();
     is_init = 0;
 }
 
+/**
+ * Get the path to an asset's file, on the assets directory
+ * 
+ * @return 0 on success, 1 if the path doesn't fit on the buffer
+ */
+int gl_getAssetPath(char *pDst, int dstLen, char *pName, char *pExt) {
+    char *pBase;
+    int rv;
+    
+    pBase = SDL_GetBasePath();
+    rv = snprintf(pDst, dstLen, "%sassets/%s.%s", pBase ? pBase : "", pName,
+            pExt);
+    if (pBase)
+        SDL_free(pBase);
+    
+    return (rv > 0 && rv < dstLen) ? 0 : 1;
+}
+
+/**
+ * Copy a 8x8 tile from the atlas into a pixel buffer (with the atlas' format),
+ * skipping any transparent pixel
+ */
+void gl_copyTile(unsigned char *pDst, int dstWidth, int tile, int x, int y) {
+    unsigned char *pSrc;
+    int i, j;
+    
+    // Get the tile's first pixel on the atlas and on the destination
+    pSrc = gl_atlasData + ((tile / (TEXW / 8)) * 8 * TEXW +
+            (tile % (TEXW / 8)) * 8) * TEXBPP;
+    pDst += (y * dstWidth + x) * TEXBPP;
+    
+    j = 0;
+    while (j < 8) {
+        i = 0;
+        while (i < 8) {
+            // Only copy opaque pixels (alpha is the last channel)
+            if (pSrc[i * TEXBPP + TEXBPP - 1] != 0)
+                memcpy(pDst + i * TEXBPP, pSrc + i * TEXBPP, TEXBPP);
+            i++;
+        }
+        pSrc += TEXW * TEXBPP;
+        pDst += dstWidth * TEXBPP;
+        j++;
+    }
+}
+
@@ -4,9 +4,13 @@
 #ifndef __GLOBAL_H_
 #define __GLOBAL_H_
 
-#include <GFraMe/GFraMe_audio.h>
 #include <GFraMe/GFraMe_error.h>
 #include <GFraMe/GFraMe_spriteset.h>
+#include <GFraMe/GFraMe_texture.h>
+
+#include "mixer.h"
+#include "packfmt.h"
+#include "tiles.h"
 
 #define SCRW    320
 #define SCRH    240
@@ -14,12 +18,20 @@
 #define WNDH    480
 #define TITLE   "KITTEN - An Unconventional Weapon - by GFM"
 #define TEX     "atlas"
-#define TEXW    256
-#define TEXH    256
-#define FPS     60
+#define PACK    "assets"
+#define TEXW    ATLAS_W
+#define TEXH    ATLAS_H
+#define TEXBPP  4   // bytes per pixel on the atlas buffer
+#ifndef DPS
+#define DPS     120 // draws per second (blended between updates)
+#endif
+#define FPS     DPS // event timer's rate; draws can't be any faster than it
 #define UPS     60  // updates per second
-#define DPS     60  // draws per second
+#define PS_MAX_CATCHUP 5    // updates run between draws before dropping time
+#define INTERP_ONE 256      // fixed-point 1.0 for the render interpolation
+#define INTERP_MAX_DIST 16  // moves bigger than this are snapped, not blended
 #define LOGTOFILE   0
+#define GL_MAX_LOADERS 4    // worker threads used to load the assets
 
 #define TXT_CHAR_DELAY 50
 #define TXT_COMPLETE_DELAY 1250
@@ -42,6 +54,28 @@
 #define CAM_MAX_RATIO 0.6
 #define CAM_MIN_RATIO 0.2
 #define RESPAWN_TIME 1500
+#define TM_CHUNK_TW (SCRW / 8)  // chunk's width, in tiles (a screen's)
+#define TM_CHUNK_TH (SCRH / 8)  // chunk's height, in tiles (a screen's)
+#define TM_EMPTY_TILE 255   // '-1' on the exported tilemap
+#define DRW_MAX_DIRTY_RECTS 8   // areas redrawn separately, before merging
+#define WG_CELL_SIZE 64     // wall grid's cell dimension, in pixels
+#define BVH_LEAF_WALLS 4    // walls kept together on a leaf of the BVH
+#define MUS_RING_LEN 32768  // bytes of the streamed song kept in memory
+#define MUS_CHUNK_LEN 4096  // bytes read from the song's file at a time
+#define MUS_DEV_SAMPLES 2048    // samples requested by each audio callback
+#define MIX_FREQ PK_PCM_FREQ    // sample rate of the sound effects' mixer
+#define MIX_MAX_VOICES 8    // sounds played at once, before stealing voices
+#define MIX_DEV_SAMPLES 512 // samples requested by each mixer's callback
+#define MIX_BLOCK_LEN 256   // samples accumulated at a time by the mixer
+#define MIX_MAX_QUEUED 16   // distinct sounds triggered on a single update
+#define MIX_COALESCE_MS 40  // window where retriggering a sound is merged
+#define MIX_MAX_CLIPS 16    // sounds that may be loaded on demand
+#define MIX_MAX_RESIDENT 262144 // bytes of loaded sounds, before evicting
+#define AUD_FULL_DIST 160   // distance from the camera heard at full volume
+#define AUD_CUTOFF_DIST 320 // distance from the camera beyond which it's mute
+#define SYN_FREQ 44100      // sample rate of synthesized songs
+#define SYN_CHANNEL_AMP 6000    // a channel's amplitude at full volume
+#define SYN_BLOCK_LEN 1024  // samples mixed at a time by the synthesizer
 
 #define ASSERT(stmt, retVal) \
   do { \
@@ -59,22 +93,41 @@
 
 extern int gl_running;
 
+/** The atlas, shared by every spriteset */
+extern GFraMe_texture *gl_tex;
+
 extern GFraMe_spriteset *gl_sset2x2;
 extern GFraMe_spriteset *gl_sset4x4;
 extern GFraMe_spriteset *gl_sset8x8;
 extern GFraMe_spriteset *gl_sset16x16;
 
-extern GFraMe_audio *gl_aud_step;
-extern GFraMe_audio *gl_aud_jump;
-extern GFraMe_audio *gl_aud_death;
-extern GFraMe_audio *gl_aud_bullet;
-extern GFraMe_audio *gl_aud_powerup;
-extern GFraMe_audio *gl_aud_revive;
-extern GFraMe_audio *gl_aud_text;
-extern GFraMe_audio *gl_aud_song1;
+/** The atlas' pixels, kept around so other textures may be composed from it */
+extern unsigned char *gl_atlasData;
+
+extern mixClip *gl_aud_step;
+extern mixClip *gl_aud_jump;
+extern mixClip *gl_aud_death;
+extern mixClip *gl_aud_bullet;
+extern mixClip *gl_aud_powerup;
+extern mixClip *gl_aud_revive;
+extern mixClip *gl_aud_text;
+extern mixClip *gl_aud_song1;
 
 GFraMe_ret gl_init();
 void gl_clean();
 
+/**
+ * Get the path to an asset's file, on the assets directory
+ * 
+ * @return 0 on success, 1 if the path doesn't fit on the buffer
+ */
+int gl_getAssetPath(char *pDst, int dstLen, char *pName, char *pExt);
+
+/**
+ * Copy a 8x8 tile from the atlas into a pixel buffer (with the atlas' format),
+ * skipping any transparent pixel
+ */
+void gl_copyTile(unsigned char *pDst, int dstWidth, int tile, int x, int y);
+
 #endif
 
@@ -4,11 +4,13 @@
  * The game's entry point
  */
 #include <GFraMe/GFraMe.h>
-#include <GFraMe/GFraMe_audio_player.h>
 #include <GFraMe/GFraMe_controller.h>
 #include <GFraMe/GFraMe_screen.h>
 
+#include "audio.h"
 #include "global.h"
+#include "mixer.h"
+#include "music.h"
 #include "playstate.h"
 
 int main(int argc, char *argv[]) {
@@ -36,8 +38,8 @@ int main(int argc, char *argv[]) {
         );
     ASSERT_NR(rv == GFraMe_ret_ok);
     
-    rv = GFraMe_audio_player_init();
-    ASSERT_NR(rv == GFraMe_ret_ok);
+    rv = mix_init();
+    ASSERT_NR(rv == 0);
 
     rv = gl_init();
     ASSERT_NR(rv == GFraMe_ret_ok);
@@ -49,8 +51,11 @@ int main(int argc, char *argv[]) {
     }
 
 __ret:
-    GFraMe_audio_player_pause();
-    GFraMe_audio_player_clear();
+#ifdef DEBUG
+    aud_dumpStats();
+#endif
+    mix_clean();
+    mus_pause();
     
     GFraMe_controller_close();
     gl_clean();
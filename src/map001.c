@@ -1355,3 +1355,12 @@ int map001_getSpikes(sprite ***pppSprs, int *pLen, int *pUsed) {
 __ret:
     return rv;
 }
+
+/** Generated tilemap's layers, from the back to the front */
+char *map001_layers[] = {map001_tilemap,};
+/** Generated tilemap's layer count */
+int map001_layersLen = 1;
+/** How fast each layer scrolls relative to the camera, in percents */
+int map001_layerParallax[] = {100,};
+/** Whether each layer is rendered in front of the sprites */
+int map001_layerIsFg[] = {0,};
@@ -15,3 +15,11 @@ int map001_getWalls(GFraMe_object **ppObjs, int *pLen, int *pUsed);
 int map001_getStones(sprite ***pppSprs, int *pLen, int *pUsed);
 /** Get all this map's walls into a GFraMe_object buffer */
 int map001_getSpikes(sprite ***pppSprs, int *pLen, int *pUsed);
+/** Generated tilemap's layers, from the back to the front */
+extern char *map001_layers[];
+/** Generated tilemap's layer count */
+extern int map001_layersLen;
+/** How fast each layer scrolls relative to the camera, in percents */
+extern int map001_layerParallax[];
+/** Whether each layer is rendered in front of the sprites */
+extern int map001_layerIsFg[];
@@ -0,0 +1,707 @@
+/**
+ * @file src/mixer.c
+ * 
+ * Mixer for sound effects (and the song, if it had to be fully decoded), with
+ * a fixed number of voices; Once every voice is taken, the least important one
+ * is stolen
+ * 
+ * Voices are accumulated in blocks into 32 bits and only then saturated into
+ * the device's buffer; On x86, both steps are done 8 samples at a time with
+ * SSE2 (which every x86_64 CPU has)
+ * 
+ * Clips are only loaded when first played (or prefetched), and the least
+ * recently played ones are released whenever the loaded samples go over
+ * MIX_MAX_RESIDENT
+ */
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_audio.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_stdinc.h>
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_timer.h>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "mixer.h"
+#include "pack.h"
+#include "wave.h"
+
+/** Maximum volume, in 8.8 fixed point */
+#define MIX_VOLUME_ONE 256
+
+/** A sound being played */
+struct stMixVoice {
+    /** The sound (0, if the voice is free) */
+    mixClip *pClip;
+    /** Next sample to be played */
+    int pos;
+    /** Volume, in 8.8 fixed point */
+    int volume;
+    /** How important the sound is */
+    mixCategory category;
+    /** When it was started, to find the oldest voice */
+    Uint32 seq;
+#ifdef DEBUG
+    /** When it was triggered (0, once it was mixed for the first time) */
+    Uint64 time;
+#endif
+};
+typedef struct stMixVoice mixVoice;
+
+/** A sound waiting to be started */
+struct stMixCmd {
+    /** The sound */
+    mixClip *pClip;
+    /** Volume, in 8.8 fixed point */
+    int volume;
+    /** How important the sound is */
+    mixCategory category;
+#ifdef DEBUG
+    /** When it was first triggered */
+    Uint64 time;
+#endif
+};
+typedef struct stMixCmd mixCmd;
+
+/** The audio device */
+static SDL_AudioDeviceID _mixDev = 0;
+/** Every voice (only touched with the device locked) */
+static mixVoice _mixVoices[MIX_MAX_VOICES];
+/** Counter of started voices */
+static Uint32 _mixSeq = 0;
+/** Sounds triggered since the last flush (only touched by the game) */
+static mixCmd _mixQueue[MIX_MAX_QUEUED];
+static int _mixQueueLen = 0;
+/** Every clip that was initialized (only touched by the game) */
+static mixClip *_mixClips[MIX_MAX_CLIPS];
+static int _mixClipsLen = 0;
+/** Bytes of samples loaded into memory (ignoring the ones on the pack) */
+static SDL_atomic_t _mixResident;
+/** Clips waiting to be loaded by the loader thread, as a ring (pushed only by
+ * the game and popped only by the loader) */
+static mixClip *_mixPending[MIX_MAX_CLIPS];
+/** Next pending clip to be loaded */
+static SDL_atomic_t _mixPendingHead;
+/** Where the next pending clip is pushed */
+static SDL_atomic_t _mixPendingTail;
+/** Posted for every pending clip (and once, with nothing pending, to stop) */
+static SDL_sem *_mixLoaderSem = 0;
+/** Thread that loads prefetched clips (0, if they are loaded right away) */
+static SDL_Thread *_mixLoader = 0;
+/** Voices are accumulated here before being saturated */
+static Sint32 _mixAcc[MIX_BLOCK_LEN];
+
+static int mix_loaderWorker(void *pArg);
+
+#ifdef DEBUG
+/** Instrumentation (only touched with the device locked) */
+static mixStats _mixStats;
+/** When the last callback started */
+static Uint64 _mixLastCallback = 0;
+
+/**
+ * Convert a performance counter interval into microseconds
+ */
+static Uint32 mix_toUs(Uint64 interval) {
+    return (Uint32)(interval * 1000000 / SDL_GetPerformanceFrequency());
+}
+
+/**
+ * Count a measure on a histogram; Bucket 'i' counts measures shorter than
+ * 2^i microseconds (and the last one counts everything longer)
+ */
+static void mix_addToHistogram(Uint32 *pHist, Uint32 us) {
+    int i;
+    
+    i = 0;
+    while (i < MIX_STATS_BUCKETS - 1 && us >= (1u << i))
+        i++;
+    pHist[i]++;
+}
+#endif /* DEBUG */
+
+/**
+ * Add samples, scaled by a 8.8 volume, to the accumulator
+ */
+static void mix_addSamples(Sint32 *pAcc, Sint16 *pSrc, int len, int volume) {
+    int i;
+    
+    i = 0;
+#ifdef __SSE2__
+    {
+        __m128i vol;
+        
+        vol = _mm_set1_epi16((short)volume);
+        while (i + 8 <= len) {
+            __m128i src, lo, hi, acc0, acc1;
+            
+            // Interleave the low and high halves of each product, getting
+            // the full 32 bits results
+            src = _mm_loadu_si128((__m128i*)(pSrc + i));
+            lo = _mm_mullo_epi16(src, vol);
+            hi = _mm_mulhi_epi16(src, vol);
+            acc0 = _mm_loadu_si128((__m128i*)(pAcc + i));
+            acc1 = _mm_loadu_si128((__m128i*)(pAcc + i + 4));
+            acc0 = _mm_add_epi32(acc0,
+                    _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 8));
+            acc1 = _mm_add_epi32(acc1,
+                    _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 8));
+            _mm_storeu_si128((__m128i*)(pAcc + i), acc0);
+            _mm_storeu_si128((__m128i*)(pAcc + i + 4), acc1);
+            i += 8;
+        }
+    }
+#endif
+    while (i < len) {
+        pAcc[i] += (pSrc[i] * volume) >> 8;
+        i++;
+    }
+}
+
+/**
+ * Saturate the accumulated samples into the output
+ */
+static void mix_store(Sint16 *pDst, Sint32 *pAcc, int len) {
+    int i;
+    
+    i = 0;
+#ifdef __SSE2__
+    while (i + 8 <= len) {
+        __m128i acc0, acc1;
+        
+        acc0 = _mm_loadu_si128((__m128i*)(pAcc + i));
+        acc1 = _mm_loadu_si128((__m128i*)(pAcc + i + 4));
+        _mm_storeu_si128((__m128i*)(pDst + i), _mm_packs_epi32(acc0, acc1));
+        i += 8;
+    }
+#endif
+    while (i < len) {
+        Sint32 val;
+        
+        val = pAcc[i];
+        val = (val > 32767) ? 32767 : val;
+        val = (val < -32768) ? -32768 : val;
+        pDst[i] = (Sint16)val;
+        i++;
+    }
+}
+
+/**
+ * Add a voice's next samples to the accumulator, releasing it once it ends
+ */
+static void mix_addVoice(mixVoice *pVoice, int len) {
+    mixClip *pClip;
+    int done;
+    
+    pClip = pVoice->pClip;
+    done = 0;
+#ifdef DEBUG
+    if (pVoice->time != 0) {
+        mix_addToHistogram(_mixStats.pLatency,
+                mix_toUs(SDL_GetPerformanceCounter() - pVoice->time));
+        pVoice->time = 0;
+    }
+#endif
+    while (done < len) {
+        int num;
+        
+        num = pClip->len - pVoice->pos;
+        if (num > len - done)
+            num = len - done;
+        mix_addSamples(_mixAcc + done, pClip->pSamples + pVoice->pos, num,
+                pVoice->volume);
+        pVoice->pos += num;
+        done += num;
+        
+        if (pVoice->pos >= pClip->len) {
+            if (!pClip->doLoop) {
+                pVoice->pClip = 0;
+                break;
+            }
+            pVoice->pos = pClip->loopPos;
+        }
+    }
+}
+
+/**
+ * Mix every voice into the device (called from the audio thread)
+ */
+static void mix_callback(void *pArg, Uint8 *pStream, int len) {
+    Sint16 *pDst;
+    int samples;
+#ifdef DEBUG
+    Uint64 start;
+    Uint32 us;
+    int i, voices;
+    
+    // If the time since the last callback is much longer than the buffer
+    // lasts, the device (most likely) ran out of samples
+    start = SDL_GetPerformanceCounter();
+    if (_mixLastCallback != 0 && mix_toUs(start - _mixLastCallback) >
+            (Uint32)((Uint64)len / sizeof(Sint16) * 2000000 / MIX_FREQ))
+        _mixStats.underruns++;
+    _mixLastCallback = start;
+    
+    voices = 0;
+    i = 0;
+    while (i < MIX_MAX_VOICES) {
+        if (_mixVoices[i].pClip)
+            voices++;
+        i++;
+    }
+    if (voices > _mixStats.maxVoices)
+        _mixStats.maxVoices = voices;
+#endif
+    
+    pDst = (Sint16*)pStream;
+    samples = len / sizeof(Sint16);
+    while (samples > 0) {
+        int i, num;
+        
+        num = samples;
+        if (num > MIX_BLOCK_LEN)
+            num = MIX_BLOCK_LEN;
+        
+        memset(_mixAcc, 0x0, sizeof(Sint32) * num);
+        i = 0;
+        while (i < MIX_MAX_VOICES) {
+            if (_mixVoices[i].pClip)
+                mix_addVoice(&_mixVoices[i], num);
+            i++;
+        }
+        mix_store(pDst, _mixAcc, num);
+        
+        pDst += num;
+        samples -= num;
+    }
+    
+#ifdef DEBUG
+    us = mix_toUs(SDL_GetPerformanceCounter() - start);
+    mix_addToHistogram(_mixStats.pCallback, us);
+    if (us > _mixStats.maxCallback)
+        _mixStats.maxCallback = us;
+    _mixStats.callbacks++;
+#endif
+}
+
+/**
+ * Open the audio device and start mixing
+ */
+int mix_init() {
+    SDL_AudioSpec spec;
+    int rv;
+    
+    memset(_mixVoices, 0x0, sizeof(_mixVoices));
+#ifdef DEBUG
+    memset(&_mixStats, 0x0, sizeof(mixStats));
+    _mixLastCallback = 0;
+#endif
+    
+    memset(&spec, 0x0, sizeof(SDL_AudioSpec));
+    spec.freq = MIX_FREQ;
+    spec.format = AUDIO_S16SYS;
+    spec.channels = 1;
+    spec.samples = MIX_DEV_SAMPLES;
+    spec.callback = mix_callback;
+    _mixDev = SDL_OpenAudioDevice(0, 0, &spec, 0, 0);
+    ASSERT(_mixDev != 0, 1);
+    
+    SDL_PauseAudioDevice(_mixDev, 0);
+    
+    // Start the prefetch loader; If it can't be started, clips are simply
+    // loaded right away
+    SDL_AtomicSet(&_mixPendingHead, 0);
+    SDL_AtomicSet(&_mixPendingTail, 0);
+    _mixLoaderSem = SDL_CreateSemaphore(0);
+    if (_mixLoaderSem)
+        _mixLoader = SDL_CreateThread(mix_loaderWorker, "sfxloader", 0);
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Load a clip's samples, already on the mixer's format, from the asset pack
+ * (or from a PCM wave on the assets directory, which isn't converted); Must
+ * only be called by whoever moved the clip into MIX_CLIP_LOADING
+ */
+static void mix_doLoad(mixClip *pClip) {
+    SDL_AudioSpec spec;
+    FILE *pFp;
+    unsigned char *pData;
+    char pPath[512];
+    unsigned int len;
+    int packedLen, rv;
+    
+    pFp = 0;
+    
+    // Packed clips were already converted, so they are used in place
+    if (pk_get(&pData, &packedLen, PK_FMT_PCM, pClip->pName) == 0) {
+        pClip->pSamples = (Sint16*)pData;
+        len = (unsigned int)packedLen;
+    }
+    else {
+        rv = gl_getAssetPath(pPath, sizeof(pPath), pClip->pName, "wav");
+        ASSERT(rv == 0, 1);
+        pFp = fopen(pPath, "rb");
+        ASSERT(pFp, 1);
+        rv = wv_readHeader(pFp, &spec, &len);
+        ASSERT(rv == 0, 1);
+        
+        // There's no conversion at runtime; Any other wave must be converted
+        // by the asset_packer
+        ASSERT(spec.format == AUDIO_S16SYS && spec.channels == 1 &&
+                spec.freq == MIX_FREQ, 1);
+        
+        pClip->pBuf = malloc(len + 1);
+        ASSERT(pClip->pBuf, 1);
+        ASSERT(len == 0 || fread(pClip->pBuf, len, 1, pFp) == 1, 1);
+        pClip->pSamples = (Sint16*)pClip->pBuf;
+        SDL_AtomicAdd(&_mixResident, (int)len);
+    }
+    
+    pClip->len = len / sizeof(Sint16);
+    if (pClip->loopPos >= pClip->len)
+        pClip->loopPos = 0;
+    
+    rv = 0;
+__ret:
+    if (pFp)
+        fclose(pFp);
+    if (rv != 0 && pClip->pBuf) {
+        free(pClip->pBuf);
+        pClip->pBuf = 0;
+    }
+    
+    SDL_AtomicSet(&pClip->state, (rv == 0) ? MIX_CLIP_LOADED :
+            MIX_CLIP_FAILED);
+}
+
+/**
+ * Load every pending clip, in order, until woken up with nothing pending
+ */
+static int mix_loaderWorker(void *pArg) {
+    while (1) {
+        int head;
+        
+        SDL_SemWait(_mixLoaderSem);
+        head = SDL_AtomicGet(&_mixPendingHead);
+        if (head == SDL_AtomicGet(&_mixPendingTail))
+            break;
+        
+        mix_doLoad(_mixPending[head % MIX_MAX_CLIPS]);
+        SDL_AtomicSet(&_mixPendingHead, head + 1);
+    }
+    
+    return 0;
+}
+
+/**
+ * Initialize a reference to a sound; Its samples are only loaded when it's
+ * first played (or by mix_loadClip/mix_prefetch)
+ */
+void mix_initClip(mixClip *pClip, char *pName, int doLoop, int loopPos) {
+    memset(pClip, 0x0, sizeof(mixClip));
+    pClip->pName = pName;
+    pClip->doLoop = doLoop;
+    pClip->loopPos = loopPos;
+    SDL_AtomicSet(&pClip->state, MIX_CLIP_UNLOADED);
+    
+    if (_mixClipsLen < MIX_MAX_CLIPS) {
+        _mixClips[_mixClipsLen] = pClip;
+        _mixClipsLen++;
+    }
+}
+
+/**
+ * Load a sound right away (waiting for it, if it's being prefetched)
+ */
+int mix_loadClip(mixClip *pClip) {
+    if (SDL_AtomicCAS(&pClip->state, MIX_CLIP_UNLOADED, MIX_CLIP_LOADING))
+        mix_doLoad(pClip);
+    while (SDL_AtomicGet(&pClip->state) == MIX_CLIP_LOADING)
+        SDL_Delay(1);
+    
+    return (SDL_AtomicGet(&pClip->state) == MIX_CLIP_LOADED) ? 0 : 1;
+}
+
+/**
+ * Start loading a sound on the background, since it's expected to be played
+ * soon
+ */
+void mix_prefetch(mixClip *pClip) {
+    unsigned char *pData;
+    int len, tail;
+    
+    if (!pClip || !SDL_AtomicCAS(&pClip->state, MIX_CLIP_UNLOADED,
+            MIX_CLIP_LOADING))
+        return;
+    
+    // A packed clip is only a lookup into the mapped pack, so it's cheaper to
+    // load it right away than to hand it to the loader
+    tail = SDL_AtomicGet(&_mixPendingTail);
+    if (!_mixLoader || pk_get(&pData, &len, PK_FMT_PCM, pClip->pName) == 0
+            || tail - SDL_AtomicGet(&_mixPendingHead) >= MIX_MAX_CLIPS) {
+        mix_doLoad(pClip);
+        return;
+    }
+    
+    _mixPending[tail % MIX_MAX_CLIPS] = pClip;
+    SDL_AtomicSet(&_mixPendingTail, tail + 1);
+    SDL_SemPost(_mixLoaderSem);
+}
+
+/**
+ * Release a sound's samples (it may be loaded again later); It must not be
+ * playing
+ */
+void mix_freeClip(mixClip *pClip) {
+    if (SDL_AtomicGet(&pClip->state) == MIX_CLIP_LOADING)
+        return;
+    
+    if (pClip->pBuf) {
+        free(pClip->pBuf);
+        SDL_AtomicAdd(&_mixResident, -(int)(pClip->len * sizeof(Sint16)));
+    }
+    pClip->pBuf = 0;
+    pClip->pSamples = 0;
+    pClip->len = 0;
+    SDL_AtomicSet(&pClip->state, MIX_CLIP_UNLOADED);
+}
+
+/**
+ * Release the least recently played clips (that aren't playing), until the
+ * loaded samples fit on MIX_MAX_RESIDENT; Must be called with the device
+ * locked
+ */
+static void mix_evict() {
+    while (SDL_AtomicGet(&_mixResident) > MIX_MAX_RESIDENT) {
+        mixClip *pOldest;
+        int i, j;
+        
+        pOldest = 0;
+        i = 0;
+        while (i < _mixClipsLen) {
+            mixClip *pClip;
+            
+            pClip = _mixClips[i];
+            i++;
+            if (SDL_AtomicGet(&pClip->state) != MIX_CLIP_LOADED ||
+                    !pClip->pBuf)
+                continue;
+            if (pOldest && (Sint32)(pClip->lastUsed - pOldest->lastUsed) >= 0)
+                continue;
+            
+            j = 0;
+            while (j < MIX_MAX_VOICES && _mixVoices[j].pClip != pClip)
+                j++;
+            if (j == MIX_MAX_VOICES)
+                pOldest = pClip;
+        }
+        
+        if (!pOldest)
+            break;
+        mix_freeClip(pOldest);
+    }
+}
+
+/**
+ * Start a queued sound (with the device locked); If the same sound was started
+ * just before, its volume is raised instead
+ */
+static void mix_start(mixCmd *pCmd) {
+    mixVoice *pSteal, *pVoice;
+    int i;
+    
+    // There's only a single song, so it replaces any previous one
+    pSteal = 0;
+    pVoice = 0;
+    i = 0;
+    while (pCmd->category == MIX_CAT_MUSIC && i < MIX_MAX_VOICES) {
+        if (_mixVoices[i].pClip && _mixVoices[i].category == MIX_CAT_MUSIC)
+            pVoice = &_mixVoices[i];
+        i++;
+    }
+    
+    // Triggers that are too close would only be heard as a louder sound (with
+    // some phasing), so merge them
+    i = 0;
+    while (!pVoice && i < MIX_MAX_VOICES) {
+        mixVoice *pCur;
+        
+        pCur = &_mixVoices[i];
+        if (pCur->pClip == pCmd->pClip &&
+                pCur->pos < MIX_FREQ * MIX_COALESCE_MS / 1000) {
+            pCur->volume += pCmd->volume;
+            if (pCur->volume > MIX_VOLUME_ONE)
+                pCur->volume = MIX_VOLUME_ONE;
+#ifdef DEBUG
+            _mixStats.merged++;
+#endif
+            return;
+        }
+        i++;
+    }
+    
+    // Otherwise, take a free voice or steal one
+    i = 0;
+    while (!pVoice && i < MIX_MAX_VOICES) {
+        if (!_mixVoices[i].pClip)
+            pVoice = &_mixVoices[i];
+        i++;
+    }
+    i = 0;
+    while (!pVoice && i < MIX_MAX_VOICES) {
+        mixVoice *pCur;
+        
+        pCur = &_mixVoices[i];
+        if (pCur->category <= pCmd->category && (!pSteal ||
+                pCur->category < pSteal->category ||
+                (pCur->category == pSteal->category &&
+                (Sint32)(pCur->seq - pSteal->seq) < 0)))
+            pSteal = pCur;
+        i++;
+    }
+    if (!pVoice)
+        pVoice = pSteal;
+#ifdef DEBUG
+    if (!pVoice)
+        _mixStats.dropped++;
+    else if (pVoice == pSteal)
+        _mixStats.stolen++;
+#endif
+    
+    if (pVoice) {
+        pVoice->pClip = pCmd->pClip;
+        pVoice->pos = 0;
+        pVoice->volume = pCmd->volume;
+        pVoice->category = pCmd->category;
+        pVoice->seq = _mixSeq;
+        _mixSeq++;
+#ifdef DEBUG
+        pVoice->time = pCmd->time;
+#endif
+    }
+}
+
+/**
+ * Queue a sound to be played on the next mix_flush; Triggering a sound that's
+ * already queued only raises its volume
+ */
+void mix_play(mixClip *pClip, double volume, mixCategory category) {
+    int i, state;
+    
+    if (!pClip)
+        return;
+    
+    // Load it on its first use; If it's still being prefetched, it's skipped
+    state = SDL_AtomicGet(&pClip->state);
+    if (state == MIX_CLIP_UNLOADED)
+        mix_loadClip(pClip);
+    if (SDL_AtomicGet(&pClip->state) != MIX_CLIP_LOADED || pClip->len == 0)
+        return;
+    pClip->lastUsed = SDL_GetTicks();
+    
+    i = 0;
+    while (i < _mixQueueLen) {
+        if (_mixQueue[i].pClip == pClip) {
+            _mixQueue[i].volume += (int)(volume * MIX_VOLUME_ONE);
+            if (_mixQueue[i].volume > MIX_VOLUME_ONE)
+                _mixQueue[i].volume = MIX_VOLUME_ONE;
+            return;
+        }
+        i++;
+    }
+    
+    if (_mixQueueLen >= MIX_MAX_QUEUED)
+        return;
+    _mixQueue[_mixQueueLen].pClip = pClip;
+    _mixQueue[_mixQueueLen].volume = (int)(volume * MIX_VOLUME_ONE);
+    _mixQueue[_mixQueueLen].category = category;
+#ifdef DEBUG
+    _mixQueue[_mixQueueLen].time = SDL_GetPerformanceCounter();
+#endif
+    _mixQueueLen++;
+}
+
+/**
+ * Start every queued sound at once; Sounds that were started within
+ * MIX_COALESCE_MS are merged with the one already playing
+ */
+void mix_flush() {
+    int i;
+    
+    if (_mixDev == 0) {
+        _mixQueueLen = 0;
+        return;
+    }
+    else if (_mixQueueLen == 0 &&
+            SDL_AtomicGet(&_mixResident) <= MIX_MAX_RESIDENT)
+        return;
+    
+    SDL_LockAudioDevice(_mixDev);
+    i = 0;
+    while (i < _mixQueueLen) {
+        mix_start(&_mixQueue[i]);
+        i++;
+    }
+    mix_evict();
+    SDL_UnlockAudioDevice(_mixDev);
+    
+    _mixQueueLen = 0;
+}
+
+#ifdef DEBUG
+/**
+ * Retrieve a copy of the mixer's instrumentation
+ */
+void mix_getStats(mixStats *pStats) {
+    if (_mixDev != 0)
+        SDL_LockAudioDevice(_mixDev);
+    memcpy(pStats, &_mixStats, sizeof(mixStats));
+    if (_mixDev != 0)
+        SDL_UnlockAudioDevice(_mixDev);
+}
+#endif /* DEBUG */
+
+/**
+ * Stop every voice and close the audio device
+ */
+void mix_clean() {
+    int i;
+    
+    if (_mixDev != 0)
+        SDL_CloseAudioDevice(_mixDev);
+    _mixDev = 0;
+    memset(_mixVoices, 0x0, sizeof(_mixVoices));
+    _mixQueueLen = 0;
+    
+    // Stop the loader, once every pending clip is loaded
+    if (_mixLoader) {
+        SDL_SemPost(_mixLoaderSem);
+        SDL_WaitThread(_mixLoader, 0);
+        _mixLoader = 0;
+    }
+    if (_mixLoaderSem)
+        SDL_DestroySemaphore(_mixLoaderSem);
+    _mixLoaderSem = 0;
+    
+    // Release every clip, waiting for any that's still being prefetched
+    i = 0;
+    while (i < _mixClipsLen) {
+        while (SDL_AtomicGet(&_mixClips[i]->state) == MIX_CLIP_LOADING)
+            SDL_Delay(1);
+        mix_freeClip(_mixClips[i]);
+        i++;
+    }
+    _mixClipsLen = 0;
+}
+
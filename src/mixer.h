@@ -0,0 +1,158 @@
+/**
+ * @file src/mixer.h
+ * 
+ * Mixer for sound effects (and the song, if it had to be fully decoded), with
+ * a fixed number of voices; Once every voice is taken, the least important one
+ * is stolen
+ */
+#ifndef __MIXER_H__
+#define __MIXER_H__
+
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_stdinc.h>
+
+/** Categories of sounds, from the least to the most important */
+typedef enum {
+    MIX_CAT_STEP = 0,
+    MIX_CAT_UI,
+    MIX_CAT_WEAPON,
+    MIX_CAT_EVENT,
+    MIX_CAT_MUSIC,
+    MIX_CAT_MAX
+} mixCategory;
+
+/** Where a clip is on its loading */
+typedef enum {
+    MIX_CLIP_UNLOADED = 0,
+    MIX_CLIP_LOADING,
+    MIX_CLIP_LOADED,
+    MIX_CLIP_FAILED
+} mixClipState;
+
+/** A sound, loaded on demand, in the mixer's format */
+struct stMixClip {
+    /** The sound's name, without its extension */
+    char *pName;
+    /** Its mixClipState */
+    SDL_atomic_t state;
+    /** When it was last played, in milliseconds */
+    Uint32 lastUsed;
+    /** Signed 16 bits mono samples */
+    Sint16 *pSamples;
+    /** Memory owned by the clip (0, if the samples are on the asset pack) */
+    void *pBuf;
+    /** How many samples there are */
+    int len;
+    /** Whether it loops */
+    int doLoop;
+    /** Sample where the loop starts */
+    int loopPos;
+};
+typedef struct stMixClip mixClip;
+
+#ifdef DEBUG
+/** Buckets on the instrumentation's histograms */
+#define MIX_STATS_BUCKETS 16
+
+/** The mixer's instrumentation; Each histogram's bucket 'i' counts measures
+ * shorter than 2^i microseconds (the last one counts everything longer) */
+struct stMixStats {
+    /** Time from mix_play until the sound is first mixed (it's then heard
+     * after the device plays whatever it had already buffered) */
+    Uint32 pLatency[MIX_STATS_BUCKETS];
+    /** Time spent on each callback */
+    Uint32 pCallback[MIX_STATS_BUCKETS];
+    /** Longest callback, in microseconds */
+    Uint32 maxCallback;
+    /** How many callbacks were run */
+    Uint32 callbacks;
+    /** Callbacks that came too late, so the device (most likely) starved */
+    Uint32 underruns;
+    /** Most voices ever in use at once */
+    int maxVoices;
+    /** Sounds merged into one already playing */
+    Uint32 merged;
+    /** Sounds that stole another's voice */
+    Uint32 stolen;
+    /** Sounds dropped because every voice was more important */
+    Uint32 dropped;
+};
+typedef struct stMixStats mixStats;
+#endif /* DEBUG */
+
+/**
+ * Open the audio device and start mixing
+ * 
+ * @return 0 on success
+ */
+int mix_init();
+
+/**
+ * Initialize a reference to a sound; Its samples are only loaded when it's
+ * first played (or by mix_loadClip/mix_prefetch), from the asset pack (or from
+ * a PCM wave on the assets directory, which isn't converted)
+ * 
+ * @param pName The sound's name, without its extension (not copied)
+ * @param doLoop Whether the sound loops
+ * @param loopPos Sample where the loop starts
+ */
+void mix_initClip(mixClip *pClip, char *pName, int doLoop, int loopPos);
+
+/**
+ * Load a sound right away (waiting for it, if it's being prefetched)
+ * 
+ * @return 0 on success
+ */
+int mix_loadClip(mixClip *pClip);
+
+/**
+ * Start loading a sound on the background, since it's expected to be played
+ * soon; Does nothing if it was already loaded
+ * 
+ * Packed sounds are loaded right away (as that's only a lookup); Others are
+ * handed to the mixer's loader thread. Must only be called by the game
+ */
+void mix_prefetch(mixClip *pClip);
+
+/**
+ * Release a sound's samples (it's loaded again when next played); It must not
+ * be playing
+ */
+void mix_freeClip(mixClip *pClip);
+
+/**
+ * Queue a sound to be played on the next mix_flush; Triggering a sound that's
+ * already queued only raises its volume; A sound that wasn't loaded yet is
+ * loaded right away (or skipped, if it's still being prefetched)
+ * 
+ * Once started, if every voice is taken, the least important one (the oldest
+ * one, if tied) is replaced, as long as it isn't more important than the new
+ * sound (otherwise, the new sound is dropped)
+ * 
+ * @param volume From 0.0 to 1.0
+ */
+void mix_play(mixClip *pClip, double volume, mixCategory category);
+
+/**
+ * Start every queued sound at once; Sounds that were started within
+ * MIX_COALESCE_MS are merged with the one already playing
+ * 
+ * If the loaded sounds take more than MIX_MAX_RESIDENT bytes, the least
+ * recently played ones (that aren't playing) are released
+ */
+void mix_flush();
+
+#ifdef DEBUG
+/**
+ * Retrieve a copy of the mixer's instrumentation
+ */
+void mix_getStats(mixStats *pStats);
+#endif /* DEBUG */
+
+/**
+ * Stop every voice, close the audio device and release every sound
+ */
+void mix_clean();
+
+#endif /* __MIXER_H__ */
+
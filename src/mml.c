@@ -0,0 +1,528 @@
+/**
+ * @file src/mml.c
+ * 
+ * Compiler from MML (Music Macro Language) into a compact event stream, played
+ * by the synthesizer
+ */
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "mml.h"
+
+/** Compiler's state */
+struct stMmlParser {
+    /** Song being compiled */
+    mmlSong *pSong;
+    /** Macros' definitions (views into the source), indexed by their letter */
+    char *ppMacros[26];
+    /** Where each macro's definition ends */
+    char *ppMacrosEnd[26];
+    /** Events of the track being compiled */
+    mmlEvent *pEvents;
+    int eventsLen;
+    int eventsCap;
+    /** Whether the track has any note or rest */
+    int hasTime;
+    /** Current octave */
+    int octave;
+    /** Default length, in ticks */
+    int length;
+};
+typedef struct stMmlParser mmlParser;
+
+static int mml_parseSeq(mmlParser *pParser, char *pStr, char *pEnd,
+        int depth);
+
+/**
+ * Skip any whitespace
+ */
+static void mml_skipSpace(char **ppStr, char *pEnd) {
+    while (*ppStr < pEnd && isspace((unsigned char)**ppStr))
+        (*ppStr)++;
+}
+
+/**
+ * Read a decimal number
+ * 
+ * @return 0 on success, 1 if there's no number
+ */
+static int mml_readNum(char **ppStr, char *pEnd, int *pVal) {
+    int rv;
+    
+    ASSERT(*ppStr < pEnd && isdigit((unsigned char)**ppStr), 1);
+    
+    *pVal = 0;
+    while (*ppStr < pEnd && isdigit((unsigned char)**ppStr)) {
+        if (*pVal < 100000)
+            *pVal = *pVal * 10 + (**ppStr - '0');
+        (*ppStr)++;
+    }
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Read an optional length (e.g., "4.") and convert it into ticks
+ */
+static int mml_readLen(mmlParser *pParser, char **ppStr, char *pEnd,
+        int *pTicks) {
+    int dot, num, rv;
+    
+    if (mml_readNum(ppStr, pEnd, &num) == 0) {
+        ASSERT(num > 0 && num <= MML_TICKS, 1);
+        *pTicks = MML_TICKS / num;
+    }
+    else
+        *pTicks = pParser->length;
+    
+    // Each dot adds half of the previous duration
+    dot = *pTicks / 2;
+    while (*ppStr < pEnd && **ppStr == '.') {
+        *pTicks += dot;
+        dot /= 2;
+        (*ppStr)++;
+    }
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Append an event to the current track
+ */
+static int mml_emit(mmlParser *pParser, int type, int arg, int len) {
+    mmlEvent *pEv;
+    int rv;
+    
+    // Split durations that don't fit on a single event (each part grows the
+    // buffer by itself)
+    while (len > 0xffff) {
+        ASSERT(type == MML_EV_REST, 1);
+        rv = mml_emit(pParser, type, arg, 0xffff);
+        ASSERT(rv == 0, 1);
+        len -= 0xffff;
+    }
+    
+    if (pParser->eventsLen >= pParser->eventsCap) {
+        mmlEvent *pTmp;
+        int cap;
+        
+        ASSERT(pParser->eventsCap < MML_MAX_EVENTS, 1);
+        cap = pParser->eventsCap ? pParser->eventsCap * 2 : 64;
+        pTmp = (mmlEvent*)realloc(pParser->pEvents, sizeof(mmlEvent) * cap);
+        ASSERT(pTmp, 1);
+        pParser->pEvents = pTmp;
+        pParser->eventsCap = cap;
+    }
+    
+    pEv = &pParser->pEvents[pParser->eventsLen];
+    pEv->type = (unsigned char)type;
+    pEv->arg = (unsigned char)arg;
+    pEv->len = (unsigned short)len;
+    pParser->eventsLen++;
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Compile a note, with its accidentals, length and ties
+ */
+static int mml_parseNote(mmlParser *pParser, char **ppStr, char *pEnd) {
+    /** Semitones of each note, from 'a' to 'g' */
+    static const int pSemitones[] = {9, 11, 0, 2, 4, 5, 7};
+    int note, ticks, tie, rv;
+    
+    note = pParser->octave * 12 + pSemitones[**ppStr - 'a'];
+    (*ppStr)++;
+    
+    if (*ppStr < pEnd && (**ppStr == '+' || **ppStr == '#')) {
+        note++;
+        (*ppStr)++;
+    }
+    else if (*ppStr < pEnd && **ppStr == '-') {
+        note--;
+        (*ppStr)++;
+    }
+    ASSERT(note >= 0 && note < 128, 1);
+    
+    rv = mml_readLen(pParser, ppStr, pEnd, &ticks);
+    ASSERT(rv == 0, 1);
+    
+    // Tied lengths are simply added together
+    while (1) {
+        char *pTmp;
+        
+        pTmp = *ppStr;
+        mml_skipSpace(&pTmp, pEnd);
+        if (pTmp >= pEnd || *pTmp != '^')
+            break;
+        pTmp++;
+        
+        rv = mml_readLen(pParser, &pTmp, pEnd, &tie);
+        ASSERT(rv == 0, 1);
+        ticks += tie;
+        *ppStr = pTmp;
+    }
+    ASSERT(ticks > 0 && ticks <= 0xffff, 1);
+    
+    rv = mml_emit(pParser, MML_EV_NOTE, note, ticks);
+    ASSERT(rv == 0, 1);
+    pParser->hasTime = 1;
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Compile a loop (starting right after its '['), expanding it
+ */
+static int mml_parseLoop(mmlParser *pParser, char **ppStr, char *pEnd,
+        int depth) {
+    char *pStart, *pLoopEnd;
+    int count, nesting, rv;
+    
+    // Find the matching ']'
+    pStart = *ppStr;
+    nesting = 0;
+    while (*ppStr < pEnd && (**ppStr != ']' || nesting > 0)) {
+        if (**ppStr == '[')
+            nesting++;
+        else if (**ppStr == ']')
+            nesting--;
+        (*ppStr)++;
+    }
+    ASSERT(*ppStr < pEnd, 1);
+    
+    pLoopEnd = *ppStr;
+    (*ppStr)++;
+    if (mml_readNum(ppStr, pEnd, &count) != 0)
+        count = 2;
+    
+    while (count > 0) {
+        rv = mml_parseSeq(pParser, pStart, pLoopEnd, depth + 1);
+        ASSERT(rv == 0, 1);
+        count--;
+    }
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Compile a sequence of commands into the current track
+ */
+static int mml_parseSeq(mmlParser *pParser, char *pStr, char *pEnd,
+        int depth) {
+    int num, ticks, rv;
+    
+    ASSERT(depth < MML_MAX_DEPTH, 1);
+    
+    while (1) {
+        char cmd;
+        
+        mml_skipSpace(&pStr, pEnd);
+        if (pStr >= pEnd)
+            break;
+        
+        cmd = *pStr;
+        if (cmd >= 'a' && cmd <= 'g') {
+            rv = mml_parseNote(pParser, &pStr, pEnd);
+            ASSERT(rv == 0, 1);
+            continue;
+        }
+        else if (cmd >= 'A' && cmd <= 'Z') {
+            ASSERT(pParser->ppMacros[cmd - 'A'], 1);
+            rv = mml_parseSeq(pParser, pParser->ppMacros[cmd - 'A'],
+                    pParser->ppMacrosEnd[cmd - 'A'], depth + 1);
+            ASSERT(rv == 0, 1);
+            pStr++;
+            continue;
+        }
+        else if (cmd == '[') {
+            pStr++;
+            rv = mml_parseLoop(pParser, &pStr, pEnd, depth);
+            ASSERT(rv == 0, 1);
+            continue;
+        }
+        
+        pStr++;
+        switch (cmd) {
+            case 'r': {
+                rv = mml_readLen(pParser, &pStr, pEnd, &ticks);
+                ASSERT(rv == 0 && ticks > 0, 1);
+                rv = mml_emit(pParser, MML_EV_REST, 0, ticks);
+                ASSERT(rv == 0, 1);
+                pParser->hasTime = 1;
+            } break;
+            case '<': pParser->octave++; break;
+            case '>': pParser->octave--; break;
+            case 'o': {
+                rv = mml_readNum(&pStr, pEnd, &pParser->octave);
+                ASSERT(rv == 0, 1);
+            } break;
+            case 'l': {
+                rv = mml_readLen(pParser, &pStr, pEnd, &ticks);
+                ASSERT(rv == 0 && ticks > 0, 1);
+                pParser->length = ticks;
+            } break;
+            case 'q': {
+                rv = mml_readNum(&pStr, pEnd, &num);
+                ASSERT(rv == 0 && num >= 1 && num <= 8, 1);
+                rv = mml_emit(pParser, MML_EV_QUANT, num, 0);
+                ASSERT(rv == 0, 1);
+            } break;
+            case 'v': {
+                rv = mml_readNum(&pStr, pEnd, &num);
+                ASSERT(rv == 0 && num <= 15, 1);
+                rv = mml_emit(pParser, MML_EV_VOLUME, num, 0);
+                ASSERT(rv == 0, 1);
+            } break;
+            case '@': {
+                rv = mml_readNum(&pStr, pEnd, &num);
+                ASSERT(rv == 0 && num < MML_WAVE_MAX, 1);
+                rv = mml_emit(pParser, MML_EV_WAVE, num, 0);
+                ASSERT(rv == 0, 1);
+            } break;
+            case 'n': {
+                ASSERT(pStr < pEnd && *pStr == 'a', 1);
+                pStr++;
+                rv = mml_readNum(&pStr, pEnd, &num);
+                ASSERT(rv == 0 && num < MML_MAX_TABLES, 1);
+                rv = mml_emit(pParser, MML_EV_ENVELOPE, num, 0);
+                ASSERT(rv == 0, 1);
+            } break;
+            case 't': {
+                rv = mml_readNum(&pStr, pEnd, &num);
+                ASSERT(rv == 0 && num > 0, 1);
+                pParser->pSong->tempo = num;
+            } break;
+            default: ASSERT(0, 1);
+        }
+    }
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Compile an envelope (everything after "#TABLE")
+ */
+static int mml_parseTable(mmlParser *pParser, char *pStr, char *pEnd) {
+    mmlTable *pTable;
+    int index, rv;
+    
+    mml_skipSpace(&pStr, pEnd);
+    rv = mml_readNum(&pStr, pEnd, &index);
+    ASSERT(rv == 0 && index < MML_MAX_TABLES, 1);
+    pTable = &pParser->pSong->pTables[index];
+    pTable->len = 0;
+    
+    mml_skipSpace(&pStr, pEnd);
+    ASSERT(pStr < pEnd && *pStr == '{', 1);
+    pStr++;
+    
+    while (1) {
+        int from, to, count, i;
+        
+        mml_skipSpace(&pStr, pEnd);
+        ASSERT(pStr < pEnd, 1);
+        if (*pStr == '}')
+            break;
+        else if (*pStr == ',') {
+            pStr++;
+            continue;
+        }
+        
+        if (*pStr == '(') {
+            // A ramp, "(from, to)count"
+            pStr++;
+            mml_skipSpace(&pStr, pEnd);
+            rv = mml_readNum(&pStr, pEnd, &from);
+            ASSERT(rv == 0, 1);
+            mml_skipSpace(&pStr, pEnd);
+            ASSERT(pStr < pEnd && *pStr == ',', 1);
+            pStr++;
+            mml_skipSpace(&pStr, pEnd);
+            rv = mml_readNum(&pStr, pEnd, &to);
+            ASSERT(rv == 0, 1);
+            mml_skipSpace(&pStr, pEnd);
+            ASSERT(pStr < pEnd && *pStr == ')', 1);
+            pStr++;
+            rv = mml_readNum(&pStr, pEnd, &count);
+            ASSERT(rv == 0 && count > 0, 1);
+        }
+        else {
+            rv = mml_readNum(&pStr, pEnd, &from);
+            ASSERT(rv == 0, 1);
+            to = from;
+            count = 1;
+        }
+        ASSERT(from <= 255 && to <= 255, 1);
+        ASSERT(pTable->len + count <= MML_MAX_TABLE_LEN, 1);
+        
+        i = 0;
+        while (i < count) {
+            int val;
+            
+            if (count > 1)
+                val = from + (to - from) * i / (count - 1);
+            else
+                val = from;
+            pTable->pValues[pTable->len] = (unsigned char)val;
+            pTable->len++;
+            i++;
+        }
+    }
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Compile a track and add it to the song (unless it has no notes at all)
+ */
+static int mml_parseTrack(mmlParser *pParser, char *pStr, char *pEnd) {
+    mmlSong *pSong;
+    int rv;
+    
+    pParser->pEvents = 0;
+    pParser->eventsLen = 0;
+    pParser->eventsCap = 0;
+    pParser->hasTime = 0;
+    pParser->octave = 4;
+    pParser->length = MML_TICKS / 4;
+    
+    rv = mml_parseSeq(pParser, pStr, pEnd, 0);
+    ASSERT(rv == 0, 1);
+    
+    if (pParser->hasTime) {
+        mmlEvent **ppTmp;
+        
+        rv = mml_emit(pParser, MML_EV_END, 0, 0);
+        ASSERT(rv == 0, 1);
+        
+        pSong = pParser->pSong;
+        ppTmp = (mmlEvent**)realloc(pSong->ppTracks,
+                sizeof(mmlEvent*) * (pSong->tracksLen + 1));
+        ASSERT(ppTmp, 1);
+        pSong->ppTracks = ppTmp;
+        pSong->ppTracks[pSong->tracksLen] = pParser->pEvents;
+        pSong->tracksLen++;
+        pParser->pEvents = 0;
+    }
+    
+    rv = 0;
+__ret:
+    if (pParser->pEvents)
+        free(pParser->pEvents);
+    pParser->pEvents = 0;
+    
+    return rv;
+}
+
+/**
+ * Compile a song; Loops and macros are expanded, so each track is played
+ * sequentially
+ */
+int mml_compile(mmlSong **ppSong, char *pText, int len) {
+    mmlParser parser;
+    char *pBuf, *pStr, *pEnd;
+    int i, rv;
+    
+    pBuf = 0;
+    memset(&parser, 0x0, sizeof(mmlParser));
+    
+    parser.pSong = (mmlSong*)malloc(sizeof(mmlSong));
+    ASSERT(parser.pSong, 1);
+    memset(parser.pSong, 0x0, sizeof(mmlSong));
+    parser.pSong->tempo = 120;
+    
+    // Work on a copy, with every comment blanked out
+    pBuf = (char*)malloc(len);
+    ASSERT(pBuf, 1);
+    memcpy(pBuf, pText, len);
+    i = 0;
+    while (i < len - 1) {
+        if (pBuf[i] == '/' && pBuf[i + 1] == '/') {
+            while (i < len && pBuf[i] != '\n' && pBuf[i] != '\r') {
+                pBuf[i] = ' ';
+                i++;
+            }
+        }
+        else
+            i++;
+    }
+    
+    pStr = pBuf;
+    while (pStr < pBuf + len) {
+        pEnd = memchr(pStr, ';', pBuf + len - pStr);
+        if (!pEnd)
+            pEnd = pBuf + len;
+        
+        mml_skipSpace(&pStr, pEnd);
+        if (pEnd - pStr >= 6 && strncmp(pStr, "#TABLE", 6) == 0) {
+            rv = mml_parseTable(&parser, pStr + 6, pEnd);
+            ASSERT(rv == 0, 1);
+        }
+        else if (pEnd - pStr >= 2 && pStr[0] == '#' && pStr[1] >= 'A' &&
+                pStr[1] <= 'Z') {
+            char *pDef;
+            
+            pDef = pStr + 2;
+            mml_skipSpace(&pDef, pEnd);
+            ASSERT(pDef < pEnd && *pDef == '=', 1);
+            parser.ppMacros[pStr[1] - 'A'] = pDef + 1;
+            parser.ppMacrosEnd[pStr[1] - 'A'] = pEnd;
+        }
+        else if (pStr < pEnd) {
+            rv = mml_parseTrack(&parser, pStr, pEnd);
+            ASSERT(rv == 0, 1);
+        }
+        
+        pStr = pEnd + 1;
+    }
+    ASSERT(parser.pSong->tracksLen > 0, 1);
+    
+    *ppSong = parser.pSong;
+    parser.pSong = 0;
+    rv = 0;
+__ret:
+    if (parser.pSong)
+        mml_free(&parser.pSong);
+    if (pBuf)
+        free(pBuf);
+    
+    return rv;
+}
+
+/**
+ * Release a compiled song
+ */
+void mml_free(mmlSong **ppSong) {
+    int i;
+    
+    if (!*ppSong)
+        return;
+    
+    i = 0;
+    while (i < (*ppSong)->tracksLen) {
+        free((*ppSong)->ppTracks[i]);
+        i++;
+    }
+    if ((*ppSong)->ppTracks)
+        free((*ppSong)->ppTracks);
+    free(*ppSong);
+    *ppSong = 0;
+}
+
@@ -0,0 +1,106 @@
+/**
+ * @file src/mml.h
+ * 
+ * Compiler from MML (Music Macro Language) into a compact event stream, played
+ * by the synthesizer
+ * 
+ * Every statement ends on a ';' and comments start with '//'. A statement may
+ * be:
+ *   t<N>                   - tempo, in quarter notes per minute
+ *   #TABLE <N> { ... };    - amplitude envelope, with a value (0 to 128) per
+ *                            tick; '(a, b)N' expands to N values from a to b
+ *   #<X>=...;              - macro, expanded wherever the letter X is used
+ *   anything else          - a track, played on its own channel
+ * 
+ * Tracks accept:
+ *   c d e f g a b [+|#|-][len][.][^len...] - note (sharp/flat, tied)
+ *   r[len][.]      - rest
+ *   o<N> < >       - octave (set, up, down)
+ *   l<N>           - default length (as a fraction of a whole note)
+ *   q<N>           - quantization; Notes sound for N/8 of their length
+ *   v<N>           - volume (0 to 15)
+ *   @<N>           - waveform (see mmlWave)
+ *   na<N>          - amplitude envelope (a #TABLE)
+ *   [ ... ]<N>     - loop, repeated N times
+ */
+#ifndef __MML_H__
+#define __MML_H__
+
+/** Ticks in a whole note */
+#define MML_TICKS 96
+/** How many envelopes may be defined and how long they may be */
+#define MML_MAX_TABLES 16
+#define MML_MAX_TABLE_LEN 64
+/** Maximum nesting of loops and macros */
+#define MML_MAX_DEPTH 8
+/** Maximum events on a single track, after expanding its loops */
+#define MML_MAX_EVENTS 16384
+
+/** Waveforms a channel may play */
+typedef enum {
+    MML_WAVE_SQUARE = 0,
+    MML_WAVE_NOISE,
+    MML_WAVE_TRIANGLE,
+    MML_WAVE_MAX
+} mmlWave;
+
+/** Types of events */
+typedef enum {
+    MML_EV_NOTE = 0,
+    MML_EV_REST,
+    MML_EV_WAVE,
+    MML_EV_VOLUME,
+    MML_EV_ENVELOPE,
+    MML_EV_QUANT,
+    MML_EV_END
+} mmlEvType;
+
+/** A single event on a track */
+struct stMmlEvent {
+    /** The event's type (a mmlEvType) */
+    unsigned char type;
+    /** Note (octave * 12 + semitone) or the new value of a parameter */
+    unsigned char arg;
+    /** How long a note or rest lasts, in ticks */
+    unsigned short len;
+};
+typedef struct stMmlEvent mmlEvent;
+
+/** An amplitude envelope; Its last value is held until the note ends */
+struct stMmlTable {
+    unsigned char pValues[MML_MAX_TABLE_LEN];
+    /** How many values there are (0, if it wasn't defined) */
+    int len;
+};
+typedef struct stMmlTable mmlTable;
+
+/** A compiled song */
+struct stMmlSong {
+    /** Tempo, in quarter notes per minute */
+    int tempo;
+    /** Every track, each ended by a MML_EV_END */
+    mmlEvent **ppTracks;
+    int tracksLen;
+    /** Every envelope */
+    mmlTable pTables[MML_MAX_TABLES];
+};
+typedef struct stMmlSong mmlSong;
+
+/**
+ * Compile a song; Loops and macros are expanded, so each track is played
+ * sequentially
+ * 
+ * @param ppSong The compiled song (must be released with mml_free)
+ * @param pText The song's source (it's not modified)
+ * @param len The source's length
+ * @return 0 on success
+ */
+int mml_compile(mmlSong **ppSong, char *pText, int len);
+
+/**
+ * Release a compiled song
+ */
+void mml_free(mmlSong **ppSong);
+
+#endif /* __MML_H__ */
+
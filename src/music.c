@@ -0,0 +1,379 @@
+/**
+ * @file src/music.c
+ * 
+ * Background music, streamed from its file (or synthesized from MML) through a
+ * small ring buffer (so only a constant amount of it is ever resident)
+ * 
+ * A reader thread keeps the ring filled (either from a wave, jumping back to
+ * the loop point whenever the song ends, or from the synthesizer), while the
+ * audio callback consumes it; Each side only ever moves its own counter, so no
+ * lock is needed
+ */
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_audio.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_thread.h>
+#ifdef DEBUG
+#  include <SDL2/SDL_timer.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "mml.h"
+#include "music.h"
+#include "pack.h"
+#include "synth.h"
+#include "wave.h"
+
+/** The song's file */
+static FILE *_musFp = 0;
+/** Offset to the song's samples on the file */
+static long _musDataOff = 0;
+/** Size of the song's samples, in bytes */
+static unsigned int _musDataLen = 0;
+/** Current position into the samples, in bytes */
+static unsigned int _musPos = 0;
+/** Whether the song loops */
+static int _musDoLoop = 0;
+/** Where the loop starts, in bytes */
+static unsigned int _musLoopPos = 0;
+/** Format of the samples (as played by the device) */
+static SDL_AudioSpec _musSpec;
+/** Device where the song is played */
+static SDL_AudioDeviceID _musDev = 0;
+/** Volume used to mix the song */
+static int _musVolume = SDL_MIX_MAXVOLUME;
+
+/** Compiled song, if it's synthesized */
+static mmlSong *_musSong = 0;
+/** Where samples are read from */
+static void (*_musSource)(unsigned char *pDst, unsigned int len) = 0;
+
+/** Decoded samples waiting to be played (kept aligned for the synthesizer) */
+static Sint16 _musRingData[MUS_RING_LEN / 2];
+static unsigned char *_musRing = (unsigned char*)_musRingData;
+/** How many bytes were ever written into the ring (moved by the reader) */
+static SDL_atomic_t _musWritten;
+/** How many bytes were ever read from the ring (moved by the callback) */
+static SDL_atomic_t _musRead;
+/** Wakes the reader whenever space is freed on the ring */
+static SDL_sem *_musSem = 0;
+/** The reader thread */
+static SDL_Thread *_musThread = 0;
+/** Signals the reader to stop */
+static SDL_atomic_t _musQuit;
+#ifdef DEBUG
+/** Instrumentation (only touched with the device locked) */
+static musStats _musStats;
+#endif
+
+/**
+ * Read samples from the file, jumping back to the loop point at its end
+ */
+static void mus_readSamples(unsigned char *pDst, unsigned int len) {
+    while (len > 0) {
+        unsigned int num;
+        
+        if (_musPos >= _musDataLen) {
+            if (!_musDoLoop) {
+                // Keep playing silence after a song that doesn't loop
+                memset(pDst, _musSpec.silence, len);
+                return;
+            }
+            _musPos = _musLoopPos;
+            fseek(_musFp, _musDataOff + _musPos, SEEK_SET);
+        }
+        
+        num = _musDataLen - _musPos;
+        if (num > len)
+            num = len;
+        if (fread(pDst, num, 1, _musFp) != 1) {
+            // Treat a truncated file as if it ended here
+            _musDataLen = _musPos;
+            continue;
+        }
+        
+        _musPos += num;
+        pDst += num;
+        len -= num;
+    }
+}
+
+/**
+ * Synthesize samples from the compiled song
+ */
+static void mus_synthSamples(unsigned char *pDst, unsigned int len) {
+    syn_render((Sint16*)pDst, len / 2);
+}
+
+/**
+ * Write samples into the ring (there must be enough space for them)
+ */
+static void mus_fillRing(unsigned int len) {
+    unsigned int off, num;
+    
+    off = (unsigned int)SDL_AtomicGet(&_musWritten) % MUS_RING_LEN;
+    num = MUS_RING_LEN - off;
+    if (num > len)
+        num = len;
+    
+    _musSource(_musRing + off, num);
+    _musSource(_musRing, len - num);
+    SDL_AtomicAdd(&_musWritten, (int)len);
+}
+
+/**
+ * Keep the ring filled until the song is stopped
+ */
+static int mus_reader(void *pArg) {
+    while (!SDL_AtomicGet(&_musQuit)) {
+        unsigned int used;
+        
+        used = (unsigned int)SDL_AtomicGet(&_musWritten) -
+                (unsigned int)SDL_AtomicGet(&_musRead);
+        if (MUS_RING_LEN - used < MUS_CHUNK_LEN)
+            SDL_SemWaitTimeout(_musSem, 100);
+        else
+            mus_fillRing(MUS_CHUNK_LEN);
+    }
+    
+    return 0;
+}
+
+/**
+ * Mix the buffered samples into the device (called from the audio thread)
+ */
+static void mus_callback(void *pArg, Uint8 *pStream, int len) {
+    unsigned int avail, num, off;
+#ifdef DEBUG
+    Uint64 start;
+    Uint32 us;
+    
+    start = SDL_GetPerformanceCounter();
+#endif
+    
+    memset(pStream, _musSpec.silence, len);
+    
+    // If the reader fell behind, play silence for whatever is missing
+    avail = (unsigned int)SDL_AtomicGet(&_musWritten) -
+            (unsigned int)SDL_AtomicGet(&_musRead);
+#ifdef DEBUG
+    if (_musStats.callbacks == 0 || avail < _musStats.minFill)
+        _musStats.minFill = avail;
+    _musStats.totalFill += avail;
+    if (avail < (unsigned int)len)
+        _musStats.underruns++;
+#endif
+    if (avail > (unsigned int)len)
+        avail = (unsigned int)len;
+    
+    off = (unsigned int)SDL_AtomicGet(&_musRead) % MUS_RING_LEN;
+    num = MUS_RING_LEN - off;
+    if (num > avail)
+        num = avail;
+    
+    SDL_MixAudioFormat(pStream, _musRing + off, _musSpec.format, num,
+            _musVolume);
+    if (avail > num)
+        SDL_MixAudioFormat(pStream + num, _musRing, _musSpec.format,
+                avail - num, _musVolume);
+    
+    SDL_AtomicAdd(&_musRead, (int)avail);
+    SDL_SemPost(_musSem);
+    
+#ifdef DEBUG
+    us = (Uint32)((SDL_GetPerformanceCounter() - start) * 1000000 /
+            SDL_GetPerformanceFrequency());
+    if (us > _musStats.maxCallback)
+        _musStats.maxCallback = us;
+    _musStats.callbacks++;
+#endif
+}
+
+/**
+ * Open a device for the song (in the song's format, which SDL converts to the
+ * hardware's, if needed), buffer its start and launch the reader
+ */
+static int mus_start() {
+    int rv;
+    
+#ifdef DEBUG
+    memset(&_musStats, 0x0, sizeof(musStats));
+#endif
+    _musSpec.samples = MUS_DEV_SAMPLES;
+    _musSpec.callback = mus_callback;
+    _musSpec.silence = (_musSpec.format == AUDIO_U8) ? 0x80 : 0x00;
+    _musDev = SDL_OpenAudioDevice(0, 0, &_musSpec, 0, 0);
+    ASSERT(_musDev != 0, 1);
+    
+    // Buffer the song's start, so it may be played right away
+    SDL_AtomicSet(&_musWritten, 0);
+    SDL_AtomicSet(&_musRead, 0);
+    SDL_AtomicSet(&_musQuit, 0);
+    mus_fillRing(MUS_RING_LEN);
+    
+    _musSem = SDL_CreateSemaphore(0);
+    ASSERT(_musSem, 1);
+    _musThread = SDL_CreateThread(mus_reader, "music", 0);
+    ASSERT(_musThread, 1);
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Open a song (a PCM wave on the assets directory) and buffer its start; It's
+ * only played on mus_play
+ */
+int mus_init(char *pName, int doLoop, int loopPos) {
+    char pPath[512];
+    int frameLen, rv;
+    
+    rv = gl_getAssetPath(pPath, sizeof(pPath), pName, "wav");
+    ASSERT(rv == 0, 1);
+    _musFp = fopen(pPath, "rb");
+    ASSERT(_musFp, 1);
+    
+    rv = wv_readHeader(_musFp, &_musSpec, &_musDataLen);
+    ASSERT(rv == 0, 1);
+    _musDataOff = ftell(_musFp);
+    
+    frameLen = _musSpec.channels * ((_musSpec.format == AUDIO_U8) ? 1 : 2);
+    ASSERT(frameLen > 0, 1);
+    _musDataLen -= _musDataLen % frameLen;
+    _musDoLoop = doLoop;
+    _musLoopPos = loopPos * frameLen;
+    if (_musLoopPos >= _musDataLen)
+        _musLoopPos = 0;
+    _musPos = 0;
+    fseek(_musFp, _musDataOff, SEEK_SET);
+    
+    _musSource = mus_readSamples;
+    rv = mus_start();
+    ASSERT(rv == 0, 1);
+    
+    rv = 0;
+__ret:
+    if (rv != 0)
+        mus_clean();
+    
+    return rv;
+}
+
+/**
+ * Compile a MML song (from the pack or from the assets directory) and buffer
+ * its start; It's only played on mus_play
+ */
+int mus_initMml(char *pName, int doLoop) {
+    unsigned char *pText;
+    char pPath[512];
+    int isPacked, len, rv;
+    
+    pText = 0;
+    isPacked = 0;
+    
+    if (pk_get(&pText, &len, PK_FMT_RAW, pName) == 0)
+        isPacked = 1;
+    else {
+        FILE *pFp;
+        
+        rv = gl_getAssetPath(pPath, sizeof(pPath), pName, "mml");
+        ASSERT(rv == 0, 1);
+        pFp = fopen(pPath, "rb");
+        ASSERT(pFp, 1);
+        
+        fseek(pFp, 0, SEEK_END);
+        len = (int)ftell(pFp);
+        fseek(pFp, 0, SEEK_SET);
+        pText = (unsigned char*)malloc(len > 0 ? len : 1);
+        if (pText && len > 0 && fread(pText, len, 1, pFp) != 1)
+            len = 0;
+        fclose(pFp);
+        ASSERT(pText && len > 0, 1);
+    }
+    
+    rv = mml_compile(&_musSong, (char*)pText, len);
+    ASSERT(rv == 0, 1);
+    rv = syn_init(_musSong, SYN_FREQ, doLoop);
+    ASSERT(rv == 0, 1);
+    
+    memset(&_musSpec, 0x0, sizeof(SDL_AudioSpec));
+    _musSpec.freq = SYN_FREQ;
+    _musSpec.format = AUDIO_S16SYS;
+    _musSpec.channels = 1;
+    
+    _musSource = mus_synthSamples;
+    rv = mus_start();
+    ASSERT(rv == 0, 1);
+    
+    rv = 0;
+__ret:
+    if (pText && !isPacked)
+        free(pText);
+    if (rv != 0)
+        mus_clean();
+    
+    return rv;
+}
+
+/**
+ * Start (or resume) playing the song
+ */
+void mus_play(double volume) {
+    ASSERT_NR(_musDev != 0);
+    
+    _musVolume = (int)(volume * SDL_MIX_MAXVOLUME);
+    SDL_PauseAudioDevice(_musDev, 0);
+__ret:
+    return;
+}
+
+/**
+ * Pause the song
+ */
+void mus_pause() {
+    if (_musDev != 0)
+        SDL_PauseAudioDevice(_musDev, 1);
+}
+
+#ifdef DEBUG
+/**
+ * Retrieve a copy of the stream's instrumentation
+ */
+void mus_getStats(musStats *pStats) {
+    if (_musDev != 0)
+        SDL_LockAudioDevice(_musDev);
+    memcpy(pStats, &_musStats, sizeof(musStats));
+    if (_musDev != 0)
+        SDL_UnlockAudioDevice(_musDev);
+}
+#endif /* DEBUG */
+
+/**
+ * Stop the song and release everything
+ */
+void mus_clean() {
+    // Stop the callback before the reader, so neither touches the ring
+    if (_musDev != 0)
+        SDL_CloseAudioDevice(_musDev);
+    _musDev = 0;
+    if (_musThread) {
+        SDL_AtomicSet(&_musQuit, 1);
+        SDL_SemPost(_musSem);
+        SDL_WaitThread(_musThread, 0);
+    }
+    _musThread = 0;
+    if (_musSem)
+        SDL_DestroySemaphore(_musSem);
+    _musSem = 0;
+    if (_musFp)
+        fclose(_musFp);
+    _musFp = 0;
+    syn_clean();
+    mml_free(&_musSong);
+}
+
@@ -0,0 +1,75 @@
+/**
+ * @file src/music.h
+ * 
+ * Background music, streamed from its file (or synthesized from MML) through a
+ * small ring buffer (so only a constant amount of it is ever resident)
+ */
+#ifndef __MUSIC_H__
+#define __MUSIC_H__
+
+#ifdef DEBUG
+#include <SDL2/SDL_stdinc.h>
+
+/** The stream's instrumentation */
+struct stMusStats {
+    /** How many callbacks were run */
+    Uint32 callbacks;
+    /** Callbacks that found fewer samples than requested on the ring */
+    Uint32 underruns;
+    /** Lowest fill level of the ring, in bytes */
+    Uint32 minFill;
+    /** Sum of the fill levels on every callback (for the average), in bytes */
+    Uint64 totalFill;
+    /** Longest callback, in microseconds */
+    Uint32 maxCallback;
+};
+typedef struct stMusStats musStats;
+#endif /* DEBUG */
+
+/**
+ * Open a song (a PCM wave on the assets directory) and buffer its start; It's
+ * only played on mus_play
+ * 
+ * @param pName The song's name, without its extension
+ * @param doLoop Whether the song loops
+ * @param loopPos Sample where the loop starts
+ * @return 0 on success
+ */
+int mus_init(char *pName, int doLoop, int loopPos);
+
+/**
+ * Compile a MML song (from the pack or from the assets directory) and buffer
+ * its start; It's only played on mus_play
+ * 
+ * @param pName The song's name, without its extension
+ * @param doLoop Whether the song loops
+ * @return 0 on success
+ */
+int mus_initMml(char *pName, int doLoop);
+
+/**
+ * Start (or resume) playing the song
+ * 
+ * @param volume From 0.0 to 1.0
+ */
+void mus_play(double volume);
+
+/**
+ * Pause the song
+ */
+void mus_pause();
+
+#ifdef DEBUG
+/**
+ * Retrieve a copy of the stream's instrumentation
+ */
+void mus_getStats(musStats *pStats);
+#endif /* DEBUG */
+
+/**
+ * Stop the song and release everything
+ */
+void mus_clean();
+
+#endif /* __MUSIC_H__ */
+
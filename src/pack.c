@@ -0,0 +1,184 @@
+/**
+ * @file src/pack.c
+ * 
+ * Asset pack, memory-mapped once and served as views into the mapping
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include "global.h"
+#include "pack.h"
+#include "packfmt.h"
+
+/** The whole pack */
+static unsigned char *_pkData = 0;
+/** Pack's size, in bytes */
+static size_t _pkLen = 0;
+
+/**
+ * Map the pack into memory
+ * 
+ * @return 0 on success (if it fails, every asset must be loaded from its own
+ *         file)
+ */
+int pk_init() {
+    packHeader *pHdr;
+    packEntry *pEntries;
+    char pPath[512];
+    int i, rv;
+#ifndef _WIN32
+    struct stat st;
+    int fd;
+    
+    fd = -1;
+#endif
+    
+    ASSERT(!_pkData, 1);
+    
+    rv = gl_getAssetPath(pPath, sizeof(pPath), PACK, "pak");
+    ASSERT(rv == 0, 1);
+    
+#ifndef _WIN32
+    fd = open(pPath, O_RDONLY);
+    ASSERT(fd >= 0, 1);
+    ASSERT(fstat(fd, &st) == 0, 1);
+    ASSERT(st.st_size >= sizeof(packHeader), 1);
+    _pkLen = (size_t)st.st_size;
+    
+    _pkData = (unsigned char*)mmap(0, _pkLen, PROT_READ, MAP_SHARED, fd, 0);
+    if (_pkData == MAP_FAILED)
+        _pkData = 0;
+    ASSERT(_pkData, 1);
+#else
+    {
+        FILE *pFp;
+        
+        pFp = fopen(pPath, "rb");
+        ASSERT(pFp, 1);
+        fseek(pFp, 0, SEEK_END);
+        _pkLen = (size_t)ftell(pFp);
+        fseek(pFp, 0, SEEK_SET);
+        
+        _pkData = (unsigned char*)malloc(_pkLen);
+        if (_pkData && fread(_pkData, _pkLen, 1, pFp) != 1) {
+            free(_pkData);
+            _pkData = 0;
+        }
+        fclose(pFp);
+        ASSERT(_pkData, 1);
+    }
+#endif
+    
+    // Validate the index, so views may be retrieved without any check
+    pHdr = (packHeader*)_pkData;
+    ASSERT(pHdr->magic == PK_MAGIC, 1);
+    ASSERT(sizeof(packHeader) + pHdr->count * sizeof(packEntry) <= _pkLen, 1);
+    pEntries = (packEntry*)(_pkData + sizeof(packHeader));
+    i = 0;
+    while (i < pHdr->count) {
+        ASSERT(pEntries[i].offset <= _pkLen, 1);
+        ASSERT(pEntries[i].size <= _pkLen - pEntries[i].offset, 1);
+        ASSERT(pEntries[i].name[PK_NAME_LEN - 1] == '\0', 1);
+        i++;
+    }
+    
+    rv = 0;
+__ret:
+#ifndef _WIN32
+    // The mapping is kept even after the file is closed
+    if (fd >= 0)
+        close(fd);
+#endif
+    if (rv != 0 && _pkData)
+        pk_clean();
+    
+    return rv;
+}
+
+/**
+ * Find an asset on the index
+ */
+static packEntry* pk_find(char *pName, pkFormat format) {
+    packHeader *pHdr;
+    packEntry *pEntries;
+    int i;
+    
+    if (!_pkData)
+        return 0;
+    
+    pHdr = (packHeader*)_pkData;
+    pEntries = (packEntry*)(_pkData + sizeof(packHeader));
+    i = 0;
+    while (i < pHdr->count) {
+        if (pEntries[i].format == format &&
+                strcmp(pEntries[i].name, pName) == 0)
+            return &pEntries[i];
+        i++;
+    }
+    
+    return 0;
+}
+
+/**
+ * Get a view to an asset's data; It's valid until pk_clean
+ * 
+ * @return 0 on success
+ */
+int pk_get(unsigned char **ppData, int *pLen, pkFormat format, char *pName) {
+    packEntry *pEntry;
+    int rv;
+    
+    pEntry = pk_find(pName, format);
+    ASSERT(pEntry, 1);
+    
+    *ppData = _pkData + pEntry->offset;
+    *pLen = (int)pEntry->size;
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Get a view to a texture's pixels; It's valid until pk_clean
+ * 
+ * @return 0 on success
+ */
+int pk_getTexture(unsigned char **ppData, char *pName, int width, int height) {
+    packEntry *pEntry;
+    int rv;
+    
+    pEntry = pk_find(pName, PK_FMT_TEX);
+    ASSERT(pEntry, 1);
+    ASSERT(pEntry->width == width && pEntry->height == height, 1);
+    ASSERT(pEntry->size == width * height * TEXBPP, 1);
+    
+    *ppData = _pkData + pEntry->offset;
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Unmap the pack
+ */
+void pk_clean() {
+    if (_pkData) {
+#ifndef _WIN32
+        munmap(_pkData, _pkLen);
+#else
+        free(_pkData);
+#endif
+    }
+    _pkData = 0;
+    _pkLen = 0;
+}
+
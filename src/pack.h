@@ -0,0 +1,39 @@
+/**
+ * @file src/pack.h
+ * 
+ * Asset pack, memory-mapped once and served as views into the mapping
+ */
+#ifndef __PACK_H__
+#define __PACK_H__
+
+#include "packfmt.h"
+
+/**
+ * Map the pack into memory
+ * 
+ * @return 0 on success (if it fails, every asset must be loaded from its own
+ *         file)
+ */
+int pk_init();
+
+/**
+ * Get a view to an asset's data; It's valid until pk_clean
+ * 
+ * @return 0 on success
+ */
+int pk_get(unsigned char **ppData, int *pLen, pkFormat format, char *pName);
+
+/**
+ * Get a view to a texture's pixels; It's valid until pk_clean
+ * 
+ * @return 0 on success
+ */
+int pk_getTexture(unsigned char **ppData, char *pName, int width, int height);
+
+/**
+ * Unmap the pack
+ */
+void pk_clean();
+
+#endif /* __PACK_H__ */
+
@@ -0,0 +1,63 @@
+/**
+ * @file src/packfmt.h
+ * 
+ * Layout of the asset pack; Shared by the game and by the asset_packer tool
+ * 
+ * The pack starts with a header, followed by its index (an array of entries)
+ * and then by every asset's data (each aligned to PK_ALIGN bytes)
+ */
+#ifndef __PACKFMT_H__
+#define __PACKFMT_H__
+
+/** Identifies a pack file (and its version) */
+#define PK_MAGIC 0x314b5047 // "GPK1"
+/** Maximum length of an asset's name (including the '\0') */
+#define PK_NAME_LEN 40
+/** Alignment of every asset's data */
+#define PK_ALIGN 16
+/** Sample rate of packed audio (which must be the mixer's) */
+#define PK_PCM_FREQ 44100
+
+/** How an asset's data is stored */
+typedef enum {
+    /** As it was on its source file */
+    PK_FMT_RAW = 0,
+    /** Texture's pixels, ready for GFraMe_texture_load */
+    PK_FMT_TEX,
+    /** Audio's samples, ready for the mixer (signed 16 bits little-endian,
+     * mono, at PK_PCM_FREQ) */
+    PK_FMT_PCM,
+} pkFormat;
+
+/** Pack's header */
+struct stPackHeader {
+    /** Must be PK_MAGIC */
+    unsigned int magic;
+    /** How many entries there are on the index */
+    unsigned int count;
+    /** Pad the header to 16 bytes */
+    unsigned int padding[2];
+};
+typedef struct stPackHeader packHeader;
+
+/** An entry on the pack's index */
+struct stPackEntry {
+    /** Asset's name (the same passed to the loading functions) */
+    char name[PK_NAME_LEN];
+    /** Offset to its data, from the start of the pack */
+    unsigned int offset;
+    /** Size of its data, in bytes */
+    unsigned int size;
+    /** How it's stored (a pkFormat) */
+    unsigned int format;
+    /** Texture's width (only for PK_FMT_TEX) */
+    unsigned int width;
+    /** Texture's height (only for PK_FMT_TEX) */
+    unsigned int height;
+    /** Pad the entry to 64 bytes */
+    unsigned int padding;
+};
+typedef struct stPackEntry packEntry;
+
+#endif /* __PACKFMT_H__ */
+
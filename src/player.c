@@ -17,6 +17,7 @@
 #include <string.h>
 
 #include "audio.h"
+#include "draw.h"
 #include "global.h"
 #include "player.h"
 #include "sprite.h"
@@ -26,11 +27,14 @@ enum { SPR_ANIM_DEF, SPR_ANIM_WALK, SPR_ANIM_JUMP, SPR_ANIM_LASER, SPR_ANIM_DEAT
 static int _pl_animData[] = 
 {
 /*fps,loop,num,frames...*/
-   8 ,  1 , 12, 80,80,80,80,81,80,82,80,80,80,80,83,
-   8 ,  1 , 8 , 84,85,86,87,84,85,88,87,
-   0 ,  0 , 1 , 82,
-   0 ,  0 , 1 , 89,
-   2 ,  0 , 1 , 90,
+   8 ,  1 , 12, TL_PL_IDLE,TL_PL_IDLE,TL_PL_IDLE,TL_PL_IDLE,TL_PL_IDLE+1,
+                TL_PL_IDLE,TL_PL_IDLE+2,TL_PL_IDLE,TL_PL_IDLE,TL_PL_IDLE,
+                TL_PL_IDLE,TL_PL_IDLE+3,
+   8 ,  1 , 8 , TL_PL_WALK,TL_PL_WALK+1,TL_PL_WALK+2,TL_PL_WALK+3,TL_PL_WALK,
+                TL_PL_WALK+1,TL_PL_WALK+4,TL_PL_WALK+3,
+   0 ,  0 , 1 , TL_PL_JUMP,
+   0 ,  0 , 1 , TL_PL_LASER,
+   2 ,  0 , 1 , TL_PL_DEATH,
 };
 
 static int _pl_animLen = 5;
@@ -147,6 +151,44 @@ void pl_collideAgainstGroup(player *pPl, GFraMe_object *pObjs, int objsLen,
     spr_collideAgainstGroup(pPl->pSpr, pObjs, objsLen, isPlFixed, isObjsFixed);
 }
 
+/**
+ * Collides a player against the walls near it
+ */
+void pl_collideAgainstWalls(player *pPl, wallGrid *pWg, int isPlFixed,
+        int isWallsFixed) {
+    spr_collideAgainstWalls(pPl->pSpr, pWg, isPlFixed, isWallsFixed);
+}
+
+/**
+ * Collides a player against the walls near it, found through a BVH
+ */
+void pl_collideAgainstBvh(player *pPl, wallBvh *pBvh, int isPlFixed,
+        int isWallsFixed) {
+    spr_collideAgainstBvh(pPl->pSpr, pBvh, isPlFixed, isWallsFixed);
+}
+
+/**
+ * Collides a player against the solid tiles near it
+ */
+void pl_collideAgainstMap(player *pPl, collMap *pCm, int isPlFixed,
+        int isWallsFixed) {
+    spr_collideAgainstMap(pPl->pSpr, pCm, isPlFixed, isWallsFixed);
+}
+
+/**
+ * Kill the player if it touches a hazard, or set its checkpoint if it touches
+ * one
+ */
+void pl_touchMap(player *pPl, collMap *pCm) {
+    if (!spr_isAlive(pPl->pSpr))
+        return;
+    
+    if (spr_overlapsMap(pPl->pSpr, pCm, CM_HAZARD))
+        pl_kill(pPl);
+    else if (spr_overlapsMap(pPl->pSpr, pCm, CM_CHECKPOINT))
+        pl_setCheckpoint(pPl);
+}
+
 /**
  * Collides a player against various sprites
  */
@@ -155,6 +197,13 @@ void pl_collideAgainstSprGroup(player *pPl, sprite **pSprs, int sprsLen,
     spr_collideAgainstSprGroup(pPl->pSpr, pSprs, sprsLen, isPlFixed, isSprsFixed);
 }
 
+/**
+ * Get the player's sprite
+ */
+void pl_getSprite(sprite **ppSpr, player *pPl) {
+    *ppSpr = pPl->pSpr;
+}
+
 /**
  * Give another stone to the player
  */
@@ -242,7 +291,12 @@ void pl_getCenter(int *x, int *y, player *pPl) {
  */
 void pl_kill(player *pPl) {
     if (spr_isAlive(pPl->pSpr)) {
-        aud_playPlDeath();
+        int x, y;
+        
+        pl_getCenter(&x, &y, pPl);
+        aud_playPlDeath(x, y);
+        // The player will (eventually) revive
+        aud_prefetchPlRevive();
     }
     spr_setAnim(pPl->pSpr, SPR_ANIM_DEATH, 1/*doReset*/);
     spr_kill(pPl->pSpr);
@@ -309,10 +363,13 @@ void pl_draw(player *pPl, camera *pCam) {
         GFraMe_sprite *pGfmSpr;
         int tile, x, y, cx, cy;
         
+        // Follow the player's interpolated position, as spr_draw does
         spr_getSprite(&pGfmSpr, pPl->pSpr);
-        cam_getPos(&cx, &cy, pCam);
+        spr_getInterpOffset(&cx, &cy, pPl->pSpr, pCam);
+        cx += cam_getView(pCam)->drawX;
+        cy += cam_getView(pCam)->drawY;
         
-        tile = 295;
+        tile = TL_PL_TARGET;
         x = pGfmSpr->obj.x + GFraMe_controllers[0].rx * PL_TARGET_DIST - cx;
         if (pGfmSpr->flipped)
             x -= 6;
@@ -320,7 +377,8 @@ void pl_draw(player *pPl, camera *pCam) {
             x += 8;
         y = pGfmSpr->obj.y - 1 + GFraMe_controllers[0].ry * PL_TARGET_DIST - cy;
         
-        GFraMe_spriteset_draw(gl_sset8x8, tile, x, y, 0/*flipped*/);
+        drw_tile(gl_sset8x8, gl_tex, tile, x, y, 0/*flipped*/,
+                DRW_LAYER_SPRITES);
         
     }
     
@@ -334,7 +392,7 @@ void pl_draw(player *pPl, camera *pCam) {
 void pl_update(player *pPl, camera *pCam, int ms) {
     GFraMe_object *pObj;
     GFraMe_sprite *pSpr;
-    int isTouchingDown, isTouchingUp, isLeft, isRight, isJump;
+    int isTouchingDown, isTouchingUp, isLeft, isRight, isJump, cx, cy;
     
     if (spr_getAnim(pPl->pSpr) == SPR_ANIM_DEATH) {
         return;
@@ -343,6 +401,8 @@ void pl_update(player *pPl, camera *pCam, int ms) {
     // Get something we can work with
     spr_getSprite(&pSpr, pPl->pSpr);
     pObj = &(pSpr->obj);
+    // Where the player's sounds are played
+    pl_getCenter(&cx, &cy, pPl);
     
     if (pPl->bulCooldown > 0)
         pPl->bulCooldown -= ms;
@@ -353,7 +413,7 @@ void pl_update(player *pPl, camera *pCam, int ms) {
         // If on the ground, reset the speed to keep the player touching the floor
         pObj->vy = PL_VY;
         if (!pPl->didPlayFall) {
-            aud_playPlFall();
+            aud_playPlFall(cx, cy);
             pPl->didPlayFall = 1;
         }
     }
@@ -397,7 +457,7 @@ void pl_update(player *pPl, camera *pCam, int ms) {
     }
     if (isJump && isTouchingDown) {
         pObj->vy = -PL_VY;
-        aud_playPlJump();
+        aud_playPlJump(cx, cy);
     }
     if (isTouchingUp) {
         pObj->vy = 0;
@@ -435,7 +495,7 @@ void pl_update(player *pPl, camera *pCam, int ms) {
         else if (pObj->vx < 0)
             pSpr->flipped = 0;
         
-        aud_playBlBullet();
+        aud_playBlBullet(cx, cy);
     }
     else if (pPl->stones != 0 && pPl->laserTimer > 0 && pPl->bulCooldown <= 0 && GFraMe_controller_max > 0 &&
             (GFraMe_controllers[0].l2 || GFraMe_controllers[0].r2)) {
@@ -464,7 +524,7 @@ void pl_update(player *pPl, camera *pCam, int ms) {
         else if (pObj->vx < 0)
             pSpr->flipped = 0;
         
-        aud_playBlBullet();
+        aud_playBlBullet(cx, cy);
     }
     else {
         pPl->isShooting = 0;
@@ -481,9 +541,10 @@ void pl_update(player *pPl, camera *pCam, int ms) {
     
     spr_update(pPl->pSpr, ms);
     
-    if (spr_didChangeFrame(pPl->pSpr) && (pSpr->cur_tile == 84 ||
-            pSpr->cur_tile == 86 || pSpr->cur_tile == 88)) {
-        aud_playPlStep();
+    if (spr_didChangeFrame(pPl->pSpr) && (pSpr->cur_tile == TL_PL_WALK
+            || pSpr->cur_tile == TL_PL_WALK + 2
+            || pSpr->cur_tile == TL_PL_WALK + 4)) {
+        aud_playPlStep(cx, cy);
     }
 }
 
@@ -9,7 +9,10 @@
 #include <GFraMe/GFraMe_error.h>
 
 #include "camera.h"
+#include "collmap.h"
 #include "sprite.h"
+#include "wallbvh.h"
+#include "wallgrid.h"
 
 /** 'Export' the player structure */
 typedef struct stPlayer player;
@@ -35,12 +38,41 @@ int pl_init(player *pPl, int x, int y);
 void pl_collideAgainstGroup(player *pPl, GFraMe_object *pObjs, int objsLen,
         int isPlFixed, int isObjsFixed);
 
+/**
+ * Collides a player against the walls near it
+ */
+void pl_collideAgainstWalls(player *pPl, wallGrid *pWg, int isPlFixed,
+        int isWallsFixed);
+
+/**
+ * Collides a player against the walls near it, found through a BVH
+ */
+void pl_collideAgainstBvh(player *pPl, wallBvh *pBvh, int isPlFixed,
+        int isWallsFixed);
+
+/**
+ * Collides a player against the solid tiles near it
+ */
+void pl_collideAgainstMap(player *pPl, collMap *pCm, int isPlFixed,
+        int isWallsFixed);
+
+/**
+ * Kill the player if it touches a hazard, or set its checkpoint if it touches
+ * one
+ */
+void pl_touchMap(player *pPl, collMap *pCm);
+
 /**
  * Collides a player against various sprites
  */
 void pl_collideAgainstSprGroup(player *pPl, sprite **pSprs, int sprsLen,
         int isPlFixed, int isSprsFixed);
 
+/**
+ * Get the player's sprite
+ */
+void pl_getSprite(sprite **ppSpr, player *pPl);
+
 /**
  * Give another stone to the player
  */
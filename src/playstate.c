@@ -8,17 +8,26 @@
 #include <GFraMe/GFraMe_object.h>
 #include <GFraMe/GFraMe_spriteset.h>
 
+#include <SDL2/SDL_timer.h>
+
 GFraMe_event_setup();
 
 #include "audio.h"
 #include "camera.h"
+#include "collmap.h"
+#include "draw.h"
 #include "global.h"
 #include "map001.h"
+#include "mixer.h"
 #include "player.h"
 #include "playstate.h"
 #include "sprite.h"
+#include "sweep.h"
 #include "text.h"
+#include "tilemap.h"
 #include "ui.h"
+#include "wallbvh.h"
+#include "wallgrid.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -54,12 +63,29 @@ struct stPlaystate {
     sprite **pPlBullets;
     /** How many plBullets there are allocated */
     int plBulletsLen;
+    /** Sprites (stones and bullets) inside the camera on the last snapshot */
+    sprite **pVisSprs;
+    /** How many sprites are visible */
+    int visSprsUsed;
+    /** How many visible sprites there are allocated */
+    int visSprsLen;
     /** The bounds of the stage */
     GFraMe_object *pWalls;
     /**  How many walls there are in use */
     int wallsUsed;
     /** How many walls there are allocated */
     int wallsLen;
+#if defined(WALL_GRID)
+    /** Grid over the walls, so only the ones near a sprite are tested */
+    wallGrid *pWallGrid;
+#elif defined(WALL_BVH)
+    /** Hierarchy over the walls, so only the ones near a sprite are tested */
+    wallBvh *pWallBvh;
+#endif
+    /** Every tile's collision flags (built from the walls and spikes) */
+    collMap *pCollMap;
+    /** Player, stones and bullets sorted by position, to collide them */
+    sweepPrune *pSap;
     /** Index of the current map */
     int curMap;
     /** Map width, in tiles */
@@ -70,8 +96,27 @@ struct stPlaystate {
     int plDeadTimer;
     /** Map's tilemap */
     unsigned char *mapBuf;
+    /** Every one of the map's layers, from the back to the front */
+    unsigned char **ppMapLayers;
+    /** How many layers the map has */
+    int mapLayersLen;
+    /** How fast each layer scrolls, in percents */
+    int *pMapLayerParallax;
+    /** Whether each layer is rendered over the sprites */
+    int *pMapLayerIsFg;
+    /** Map's pre-rendered tilemaps (consecutive layers are grouped if they
+     * scroll together) */
+    tilemap **pTms;
+    /** How many tilemaps there are in use */
+    int tmsUsed;
+    /** How many tilemaps there are allocated */
+    int tmsLen;
     /** Current state */
     int state;
+    /** When the last update was run, in milliseconds */
+    unsigned int lastStepTime;
+    /** How many updates were run since the last draw */
+    int stepsSinceDraw;
 #ifdef DEBUG
     int skippedFrames;
 #endif /* DEBUG */
@@ -80,6 +125,11 @@ struct stPlaystate {
 void ps_event(struct stPlaystate *pPs);
 int ps_setMap(struct stPlaystate *pPs, int map);
 void ps_drawMap(struct stPlaystate *pPs);
+int ps_initTilemaps(struct stPlaystate *pPs);
+void ps_updateVisibility(struct stPlaystate *pPs);
+int ps_initCollMap(struct stPlaystate *pPs);
+void ps_markCheckpoints(struct stPlaystate *pPs);
+int ps_initSweep(struct stPlaystate *pPs);
 
 int ps_init(struct stPlaystate *pPs) {
     int rv;
@@ -98,6 +148,21 @@ int ps_init(struct stPlaystate *pPs) {
     rv = cam_getNew(&pPs->pCam);
     ASSERT_NR(rv == 0);
     
+    // Initialize the walls' broadphase
+#if defined(WALL_GRID)
+    rv = wg_getNew(&pPs->pWallGrid);
+    ASSERT_NR(rv == 0);
+#elif defined(WALL_BVH)
+    rv = bvh_getNew(&pPs->pWallBvh);
+    ASSERT_NR(rv == 0);
+#endif
+    rv = cm_getNew(&pPs->pCollMap);
+    ASSERT_NR(rv == 0);
+    rv = sap_getNew(&pPs->pSap);
+    ASSERT_NR(rv == 0);
+    // Positional sounds are heard by the camera
+    aud_setListener(pPs->pCam);
+    
     // Get the current map
     rv = ps_setMap(pPs, 0);
     ASSERT_NR(rv == 0);
@@ -126,6 +191,13 @@ while (pPs->skippedFrames > 0) {
 #endif
     int i;
     
+    // If the simulation fell too far behind, drop the remaining time instead
+    // of spiralling trying to catch up
+    if (pPs->stepsSinceDraw >= PS_MAX_CATCHUP)
+        goto __skip_step;
+    pPs->stepsSinceDraw++;
+    pPs->lastStepTime = SDL_GetTicks();
+    
 #ifdef DEBUG
     if (GFraMe_keys.r || (GFraMe_controller_max && GFraMe_controllers[0].a)) {
         pl_revive(pPs->pPl);
@@ -198,6 +270,9 @@ while (pPs->skippedFrames > 0) {
             
             rv = spr_recycle(&pSpr, &pPs->pPlBullets, &pPs->plBulletsLen);
             if (rv != 0) goto __next_stone;
+            rv = sap_add(pPs->pSap, pSpr, SAP_PL_BULLET, 0/*mask*/,
+                    0/*isFixed*/);
+            if (rv != 0) goto __next_stone;
             
             switch (curStone) {
                 case SPR_RED_STONE:
@@ -261,18 +336,24 @@ __next_stone:
     i = 0;
     while (i < pPs->plBulletsLen) {
         spr_update(pPs->pPlBullets[i], GFraMe_event_elapsed);
-        if (!spr_isInsideCamera(pPs->pPlBullets[i], pPs->pCam))
-            spr_kill(pPs->pPlBullets[i]);
         i++;
     }
     
     // Collide everything
-    pl_collideAgainstGroup(pPs->pPl, pPs->pWalls, pPs->wallsLen,
-        0 /*isPlFixed*/, 1/*isObjsFixed*/);
-    pl_collideAgainstSprGroup(pPs->pPl, pPs->pStones, pPs->stonesUsed,
-        0 /*isPlFixed*/, 0/*isObjsFixed*/);
-    pl_collideAgainstSprGroup(pPs->pPl, pPs->pSpikes, pPs->spikesUsed,
-        0 /*isPlFixed*/, 0/*isObjsFixed*/);
+#if defined(WALL_GRID)
+    pl_collideAgainstWalls(pPs->pPl, pPs->pWallGrid,
+        0 /*isPlFixed*/, 1/*isWallsFixed*/);
+#elif defined(WALL_BVH)
+    pl_collideAgainstBvh(pPs->pPl, pPs->pWallBvh,
+        0 /*isPlFixed*/, 1/*isWallsFixed*/);
+#else
+    pl_collideAgainstMap(pPs->pPl, pPs->pCollMap,
+        0 /*isPlFixed*/, 1/*isWallsFixed*/);
+#endif
+    // Only sprites next to each other (along the x axis) are tested
+    sap_collide(pPs->pSap);
+    // Spikes and checkpoints are only looked up on the tiles under the player
+    pl_touchMap(pPs->pPl, pPs->pCollMap);
     
     {
         int num;
@@ -281,6 +362,7 @@ __next_stone:
         if (pPs->state < num) {
             pPs->state++;
             txt_setText(pPs->pText, pPs->state);
+            ps_markCheckpoints(pPs);
         }
     }
     txt_update(pPs->pText, GFraMe_event_elapsed);
@@ -310,6 +392,11 @@ __next_stone:
         
         cam_setDeadzone(pPs->pCam, w, h);
     }
+    // Cull everything against the camera's new position
+    ps_updateVisibility(pPs);
+    // Start every sound triggered on this update at once
+    mix_flush();
+__skip_step: ;
 #ifdef DEBUG
     pPs->skippedFrames--;
 }
@@ -322,33 +409,53 @@ __next_stone:
 
 void ps_draw(struct stPlaystate *pPs) {
   GFraMe_event_draw_begin();
+    unsigned int alpha;
     int i;
     
+    // Blend everything between the last two updates, by how long ago the last
+    // one was run
+    alpha = (SDL_GetTicks() - pPs->lastStepTime) * UPS * INTERP_ONE / 1000;
+    if (alpha > INTERP_ONE)
+        alpha = INTERP_ONE;
+    cam_interpolate(pPs->pCam, (int)alpha);
+    pPs->stepsSinceDraw = 0;
+    
     ps_drawMap(pPs);
     
     i = 0;
-    while (i < pPs->stonesUsed) {
-        spr_draw(pPs->pStones[i], pPs->pCam);
-        i++;
-    }
-    i = 0;
-    while (i < pPs->plBulletsLen) {
-        spr_draw(pPs->pPlBullets[i], pPs->pCam);
+    while (i < pPs->visSprsUsed) {
+        spr_draw(pPs->pVisSprs[i], pPs->pCam);
         i++;
     }
     pl_draw(pPs->pPl, pPs->pCam);
     ui_draw(pPs->pPl);
     txt_draw(pPs->pText);
+    
+    // Issue every queued draw, grouped by texture
+    drw_flush();
   GFraMe_event_draw_end();
 }
 
 void ps_clean(struct stPlaystate *pPs) {
     if (pPs->pPl)
         pl_free(&pPs->pPl);
-    if (pPs->pCam)
+    if (pPs->pCam) {
+        aud_setListener(0);
         cam_free(&pPs->pCam);
+    }
     if (pPs->pText)
         txt_free(&pPs->pText);
+    if (pPs->pTms) {
+        int i;
+        
+        i = 0;
+        while (i < pPs->tmsLen) {
+            tm_free(&(pPs->pTms[i]));
+            i++;
+        }
+        free(pPs->pTms);
+        pPs->pTms = 0;
+    }
     if (pPs->pStones) {
         int i;
         
@@ -382,10 +489,26 @@ void ps_clean(struct stPlaystate *pPs) {
         free(pPs->pPlBullets);
         pPs->pPlBullets = 0;
     }
+    if (pPs->pVisSprs) {
+        free(pPs->pVisSprs);
+        pPs->pVisSprs = 0;
+    }
+#if defined(WALL_GRID)
+    if (pPs->pWallGrid)
+        wg_free(&pPs->pWallGrid);
+#elif defined(WALL_BVH)
+    if (pPs->pWallBvh)
+        bvh_free(&pPs->pWallBvh);
+#endif
+    if (pPs->pCollMap)
+        cm_free(&pPs->pCollMap);
+    if (pPs->pSap)
+        sap_free(&pPs->pSap);
     if (pPs->pWalls) {
         free(pPs->pWalls);
         pPs->pWalls = 0;
     }
+    drw_clean();
 }
 
 void playstate() {
@@ -470,6 +593,10 @@ int ps_setMap(struct stPlaystate *pPs, int map) {
             pPs->mapWidth = map001_width;
             pPs->mapHeight = map001_height;
             pPs->mapBuf = (unsigned char*)map001_tilemap;
+            pPs->ppMapLayers = (unsigned char**)map001_layers;
+            pPs->mapLayersLen = map001_layersLen;
+            pPs->pMapLayerParallax = map001_layerParallax;
+            pPs->pMapLayerIsFg = map001_layerIsFg;
             // Get the stones of power
             rv = map001_getStones(&pPs->pStones, &pPs->stonesLen, &pPs->stonesUsed);
             ASSERT_NR(rv == 0);
@@ -479,8 +606,32 @@ int ps_setMap(struct stPlaystate *pPs, int map) {
         }
     }
     
+    // Index the walls, so collisions only test the ones near each sprite
+#if defined(WALL_GRID)
+    rv = wg_init(pPs->pWallGrid, pPs->pWalls, pPs->wallsUsed,
+            pPs->mapWidth * 8, pPs->mapHeight * 8);
+    ASSERT_NR(rv == 0);
+#elif defined(WALL_BVH)
+    rv = bvh_init(pPs->pWallBvh, pPs->pWalls, pPs->wallsUsed);
+    ASSERT_NR(rv == 0);
+#endif
+    
+    // Flag every tile covered by a wall or a spike
+    rv = ps_initCollMap(pPs);
+    ASSERT_NR(rv == 0);
+    
+    // Register the sprites that collide against each other
+    rv = ps_initSweep(pPs);
+    ASSERT_NR(rv == 0);
+    
+    // Pre-render the map's chunks
+    rv = ps_initTilemaps(pPs);
+    ASSERT_NR(rv == 0);
+    
     // TODO do something if the map is smaller than the screen
     cam_init(pPs->pCam, SCRW, SCRH, pPs->mapWidth * 8, pPs->mapHeight * 8);
+    ps_updateVisibility(pPs);
+    drw_invalidate();
     
     rv = 0;
 __ret:
@@ -488,44 +639,212 @@ __ret:
 }
 
 void ps_drawMap(struct stPlaystate *pPs) {
-    int camX, camY, camW, camH, firstTile, dX, i, iniX, offX, x, y;
+    int i;
     
-    // TODO do something if the map is smaller than the screen
+    // Each tilemap is queued on its own layer, so their order is kept
+    i = 0;
+    while (i < pPs->tmsUsed) {
+        tm_draw(pPs->pTms[i], pPs->pCam);
+        i++;
+    }
+}
+
+/**
+ * Composite the map's layers into tilemaps; Consecutive layers that scroll
+ * together (and are on the same side of the sprites) share a single tilemap,
+ * so each group costs a single pass
+ */
+int ps_initTilemaps(struct stPlaystate *pPs) {
+    int bgCount, fgCount, i, rv;
     
-    cam_getParams(&camX, &camY, &camW, &camH, pPs->pCam);
+    pPs->tmsUsed = 0;
+    bgCount = 0;
+    fgCount = 0;
+    i = 0;
+    while (i < pPs->mapLayersLen) {
+        drwLayer layer;
+        int j, parallax, isFg;
+        
+        // Find every consecutive layer that may be composited with this one
+        parallax = pPs->pMapLayerParallax[i];
+        isFg = pPs->pMapLayerIsFg[i];
+        j = i + 1;
+        while (j < pPs->mapLayersLen && pPs->pMapLayerParallax[j] == parallax
+                && pPs->pMapLayerIsFg[j] == isFg)
+            j++;
+        
+        // Select where the group is rendered; Groups that end up on the same
+        // layer are kept in the map's order by their first layer's index
+        if (isFg) {
+            layer = DRW_LAYER_FG + fgCount;
+            if (fgCount < DRW_MAX_FG_LAYERS - 1)
+                fgCount++;
+        }
+        else if (parallax != 100) {
+            layer = DRW_LAYER_BG + bgCount;
+            if (bgCount < DRW_MAX_BG_LAYERS - 1)
+                bgCount++;
+        }
+        else
+            layer = DRW_LAYER_MAP;
+        
+        // Expand the tilemaps, as needed
+        if (pPs->tmsUsed >= pPs->tmsLen) {
+            pPs->pTms = (tilemap**)realloc(pPs->pTms,
+                    sizeof(tilemap*) * (pPs->tmsLen + 1));
+            ASSERT(pPs->pTms, 1);
+            pPs->pTms[pPs->tmsLen] = 0;
+            rv = tm_getNew(&pPs->pTms[pPs->tmsLen]);
+            ASSERT_NR(rv == 0);
+            pPs->tmsLen++;
+        }
+        
+        rv = tm_init(pPs->pTms[pPs->tmsUsed], pPs->ppMapLayers + i, j - i,
+                pPs->mapWidth, pPs->mapHeight, parallax, layer, i);
+        ASSERT_NR(rv == 0);
+        pPs->tmsUsed++;
+        
+        i = j;
+    }
     
-    // Get the first tile's position on the screen
-    iniX = -(camX % 8);
-    y = -(camY % 8);
-    // Get the first tile on the screen
-    firstTile = camX / 8 + camY / 8 * pPs->mapWidth;
-    // Get how many tiles are skipped each row
-    dX = pPs->mapWidth - camW / 8;
-    // if the camera's position doesn't match a tile, it will render 1 extra tile
-    if (iniX != 0)
-        dX--;
+    rv = 0;
+__ret:
+    return rv;
+}
+
+
+/**
+ * Append a sprite to the visible list, expanding it as needed
+ */
+static void ps_addVisible(struct stPlaystate *pPs, sprite *pSpr) {
+    if (pPs->visSprsUsed >= pPs->visSprsLen) {
+        sprite **pTmp;
+        int len;
+        
+        len = pPs->visSprsLen * 2;
+        if (len == 0)
+            len = 32;
+        pTmp = (sprite**)realloc(pPs->pVisSprs, sizeof(sprite*) * len);
+        if (!pTmp)
+            return;
+        pPs->pVisSprs = pTmp;
+        pPs->visSprsLen = len;
+    }
+    
+    pPs->pVisSprs[pPs->visSprsUsed] = pSpr;
+    pPs->visSprsUsed++;
+}
+
+/**
+ * Snapshot the camera and list every sprite inside it; Bullets that left the
+ * view are killed
+ */
+void ps_updateVisibility(struct stPlaystate *pPs) {
+    int i;
+    
+    cam_snapshot(pPs->pCam);
+    
+    pPs->visSprsUsed = 0;
+    i = 0;
+    while (i < pPs->stonesUsed) {
+        if (spr_isInsideCamera(pPs->pStones[i], pPs->pCam)) {
+            ps_addVisible(pPs, pPs->pStones[i]);
+            // A stone on screen will most likely be picked up
+            aud_prefetchPlGetStone();
+        }
+        i++;
+    }
+    i = 0;
+    while (i < pPs->plBulletsLen) {
+        if (spr_isInsideCamera(pPs->pPlBullets[i], pPs->pCam))
+            ps_addVisible(pPs, pPs->pPlBullets[i]);
+        else if (spr_isAlive(pPs->pPlBullets[i]))
+            spr_kill(pPs->pPlBullets[i]);
+        i++;
+    }
+}
+
+/**
+ * Build the collision map from the walls (solid) and the spikes (hazards)
+ */
+int ps_initCollMap(struct stPlaystate *pPs) {
+    int i, rv;
+    
+    rv = cm_init(pPs->pCollMap, pPs->mapWidth, pPs->mapHeight);
+    ASSERT(rv == 0, 1);
+    
+    i = 0;
+    while (i < pPs->wallsUsed) {
+        GFraMe_hitbox *pHb;
+        
+        pHb = &pPs->pWalls[i].hitbox;
+        cm_setRect(pPs->pCollMap, pPs->pWalls[i].x + pHb->cx - pHb->hw,
+                pPs->pWalls[i].y + pHb->cy - pHb->hh, pHb->hw * 2, pHb->hh * 2,
+                CM_SOLID);
+        i++;
+    }
+    i = 0;
+    while (i < pPs->spikesUsed) {
+        int h, w, x, y;
+        
+        spr_getBounds(&x, &y, &w, &h, pPs->pSpikes[i]);
+        rv = cm_addArea(pPs->pCollMap, x, y, w, h, CM_HAZARD);
+        ASSERT(rv == 0, 1);
+        i++;
+    }
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Add the area of every stone that was turned into a checkpoint
+ */
+void ps_markCheckpoints(struct stPlaystate *pPs) {
+    int i;
     
-    // Loop through every tile
     i = 0;
-    x = iniX;
-    offX = 0;
-    while (1) {
-        // CHeck that the tile is still valid
-        if (i >= pPs->mapWidth * pPs->mapHeight)
-            break;
-        // Render the tile to the screen
-        GFraMe_spriteset_draw(gl_sset8x8, pPs->mapBuf[firstTile + offX + i], x,
-                y, 0 /* flipped */);
-        // Updates the tile positions
-        x += 8;
-        if (x >= camW) {
-            x = iniX;
-            y += 8;
-            offX += dX;
+    while (i < pPs->stonesUsed) {
+        if (spr_getType(pPs->pStones[i]) == SPR_CHECKPOINT) {
+            int h, w, x, y;
+            
+            spr_getBounds(&x, &y, &w, &h, pPs->pStones[i]);
+            cm_addArea(pPs->pCollMap, x, y, w, h, CM_CHECKPOINT);
         }
-        if (y > camH)
-            break;
         i++;
     }
 }
 
+/**
+ * Register the player, the stones and the bullets on the sweep-and-prune
+ */
+int ps_initSweep(struct stPlaystate *pPs) {
+    sprite *pSpr;
+    int i, rv;
+    
+    sap_clear(pPs->pSap);
+    
+    pl_getSprite(&pSpr, pPs->pPl);
+    rv = sap_add(pPs->pSap, pSpr, SAP_PLAYER, SAP_STONE, 0/*isFixed*/);
+    ASSERT(rv == 0, 1);
+    
+    i = 0;
+    while (i < pPs->stonesUsed) {
+        rv = sap_add(pPs->pSap, pPs->pStones[i], SAP_STONE, 0/*mask*/,
+                0/*isFixed*/);
+        ASSERT(rv == 0, 1);
+        i++;
+    }
+    i = 0;
+    while (i < pPs->plBulletsLen) {
+        rv = sap_add(pPs->pSap, pPs->pPlBullets[i], SAP_PL_BULLET, 0/*mask*/,
+                0/*isFixed*/);
+        ASSERT(rv == 0, 1);
+        i++;
+    }
+    
+    rv = 0;
+__ret:
+    return rv;
+}
@@ -13,37 +13,41 @@
 #include <string.h>
 
 #include "collision.h"
+#include "collmap.h"
+#include "draw.h"
 #include "global.h"
 #include "sprite.h"
+#include "wallbvh.h"
+#include "wallgrid.h"
 
-int _sprRedStoneData[] = {0,0,1,288};
+int _sprRedStoneData[] = {0,0,1,TL_STONE+0};
 int _sprRedStoneAnimLen = 1;
-int _sprOrangeStoneData[] = {0,0,1,289};
+int _sprOrangeStoneData[] = {0,0,1,TL_STONE+1};
 int _sprOrangeStoneAnimLen = 1;
-int _sprYellowStoneData[] = {0,0,1,290};
+int _sprYellowStoneData[] = {0,0,1,TL_STONE+2};
 int _sprYellowStoneAnimLen = 1;
-int _sprGreenStoneData[] = {0,0,1,291};
+int _sprGreenStoneData[] = {0,0,1,TL_STONE+3};
 int _sprGreenStoneAnimLen = 1;
-int _sprCyanStoneData[] = {0,0,1,292};
+int _sprCyanStoneData[] = {0,0,1,TL_STONE+4};
 int _sprCyanStoneAnimLen = 1;
-int _sprBlueStoneData[] = {0,0,1,293};
+int _sprBlueStoneData[] = {0,0,1,TL_STONE+5};
 int _sprBlueStoneAnimLen = 1;
-int _sprPurpleStoneData[] = {0,0,1,294};
+int _sprPurpleStoneData[] = {0,0,1,TL_STONE+6};
 int _sprPurpleStoneAnimLen = 1;
 
-int _sprRedBulAnimData[] = {0,0,1,1024};
+int _sprRedBulAnimData[] = {0,0,1,TL_BULLET+0};
 int _sprRedBulAnimLen = 1;
-int _sprOrangeBulAnimData[] = {0,0,1,1025};
+int _sprOrangeBulAnimData[] = {0,0,1,TL_BULLET+1};
 int _sprOrangeBulAnimLen = 1;
-int _sprYellowBulAnimData[] = {0,0,1,1026};
+int _sprYellowBulAnimData[] = {0,0,1,TL_BULLET+2};
 int _sprYellowBulAnimLen = 1;
-int _sprGreenBulAnimData[] = {0,0,1,1027};
+int _sprGreenBulAnimData[] = {0,0,1,TL_BULLET+3};
 int _sprGreenBulAnimLen = 1;
-int _sprCyanBulAnimData[] = {0,0,1,1028};
+int _sprCyanBulAnimData[] = {0,0,1,TL_BULLET+4};
 int _sprCyanBulAnimLen = 1;
-int _sprBlueBulAnimData[] = {0,0,1,1029};
+int _sprBlueBulAnimData[] = {0,0,1,TL_BULLET+5};
 int _sprBlueBulAnimLen = 1;
-int _sprPurpleBulAnimData[] = {0,0,1,1030};
+int _sprPurpleBulAnimData[] = {0,0,1,TL_BULLET+6};
 int _sprPurpleBulAnimLen = 1;
 
 /** 'Export' the sprite structure */
@@ -68,6 +72,10 @@ struct stSprite {
     int isActive;
     /** Whether the sprite is visible and drawn */
     int isVisible;
+    /** Position at the end of the previous update, used to interpolate */
+    int prevX;
+    /** Position at the end of the previous update, used to interpolate */
+    int prevY;
 };
 
 /**
@@ -203,6 +211,8 @@ int spr_init(sprite *pSpr, int x, int y, int offX, int offY, int width,
     
     GFraMe_sprite_init(pSpr->pSelf, x, y, hitboxWidth, hitboxHeight, pSset,
             offX, offY);
+    pSpr->prevX = x;
+    pSpr->prevY = y;
     
     if (pSpr->isVisible && animLen > pSpr->animLen) {
         pSpr->pAnims = (GFraMe_animation*)realloc(pSpr->pAnims,
@@ -292,15 +302,45 @@ int spr_didAnimationFinish(sprite *pSpr) {
     return pSpr->pSelf->anim == 0;
 }
 
+/**
+ * Get how much the camera must be offset so the sprite is rendered on its
+ * interpolated position (i.e., how far the sprite is ahead of it)
+ */
+void spr_getInterpOffset(int *pDx, int *pDy, sprite *pSpr, camera *pCam) {
+    const camView *pView;
+    GFraMe_object *pObj;
+    
+    pView = cam_getView(pCam);
+    pObj = &(pSpr->pSelf->obj);
+    
+    *pDx = pObj->x - pSpr->prevX;
+    *pDy = pObj->y - pSpr->prevY;
+    // Anything that moved too far was teleported, so don't interpolate it
+    if (*pDx > INTERP_MAX_DIST || *pDx < -INTERP_MAX_DIST ||
+            *pDy > INTERP_MAX_DIST || *pDy < -INTERP_MAX_DIST) {
+        *pDx = 0;
+        *pDy = 0;
+    }
+    *pDx = *pDx * (INTERP_ONE - pView->alpha) / INTERP_ONE;
+    *pDy = *pDy * (INTERP_ONE - pView->alpha) / INTERP_ONE;
+}
+
 /**
  * Draw the sprite
  */
 void spr_draw(sprite *pSpr, camera *pCam) {
-    int camX, camY, camW, camH;
+    const camView *pView;
+    int dx, dy;
     
     if (pSpr->isActive && pSpr->isVisible) {
-        cam_getParams(&camX, &camY, &camW, &camH, pCam);
-        GFraMe_sprite_draw_camera(pSpr->pSelf, camX, camY, camW, camH);
+        pView = cam_getView(pCam);
+        
+        // Instead of moving the sprite back to its interpolated position,
+        // offset the camera by the same amount
+        spr_getInterpOffset(&dx, &dy, pSpr, pCam);
+        
+        drw_sprite(pSpr->pSelf, gl_tex, pView->drawX + dx, pView->drawY + dy,
+                pView->w, pView->h, DRW_LAYER_SPRITES);
     }
 }
 
@@ -310,6 +350,8 @@ void spr_draw(sprite *pSpr, camera *pCam) {
 void spr_update(sprite *pSpr, int ms) {
     if (pSpr->isActive) {
         pSpr->didChangeFrame = 0;
+        pSpr->prevX = pSpr->pSelf->obj.x;
+        pSpr->prevY = pSpr->pSelf->obj.y;
         
         GFraMe_sprite_update(pSpr->pSelf, ms);
         
@@ -324,18 +366,11 @@ void spr_update(sprite *pSpr, int ms) {
  * Returns whether the sprite is inside the camera
  */
 int spr_isInsideCamera(sprite *pSpr, camera *pCam) {
-    GFraMe_object *pObj;
-    int camX, camY, camW, camH, rv;
+    int rv;
     
     ASSERT(pSpr->isActive, 0);
     
-    cam_getParams(&camX, &camY, &camW, &camH, pCam);
-    pObj = &(pSpr->pSelf->obj);
-    
-    ASSERT(pObj->x + pObj->hitbox.cx + pObj->hitbox.hw >= camX && pObj->x <= camX + camW, 0);
-    ASSERT(pObj->y + pObj->hitbox.cy + pObj->hitbox.hh >= camY && pObj->y <= camY + camH, 0);
-    
-    rv = 1;
+    rv = cam_isInside(pCam, &(pSpr->pSelf->obj));
 __ret:
     return rv;
 }
@@ -347,6 +382,23 @@ void spr_getSprite(GFraMe_sprite **ppSpr, sprite *pSpr) {
     *ppSpr = pSpr->pSelf;
 }
 
+/**
+ * Get how two objects are separated, given which of them are fixed
+ */
+static GFraMe_collision_type spr_getCollisionMode(int isFirstFixed,
+        int isSecondFixed) {
+    if (isFirstFixed && isSecondFixed) {
+        return GFraMe_collision_full;
+    }
+    else if (isFirstFixed) {
+        return GFraMe_first_fixed;
+    }
+    else if (isSecondFixed) {
+        return GFraMe_second_fixed;
+    }
+    return GFraMe_dont_collide;
+}
+
 /**
  * Collides a sprite against various objects
  */
@@ -357,19 +409,7 @@ void spr_collideAgainstGroup(sprite *pSpr, GFraMe_object *pObjs, int objsLen,
     int i;
     
     pObj = &(pSpr->pSelf->obj);
-    
-    if (isPlFixed && isObjsFixed) {
-        mode = GFraMe_collision_full;
-    }
-    else if (isPlFixed) {
-        mode = GFraMe_first_fixed;
-    }
-    else if (isObjsFixed) {
-        mode = GFraMe_second_fixed;
-    }
-    else {
-        mode = GFraMe_dont_collide;
-    }
+    mode = spr_getCollisionMode(isPlFixed, isObjsFixed);
     
     i = 0;
     while (i < objsLen) {
@@ -379,44 +419,120 @@ void spr_collideAgainstGroup(sprite *pSpr, GFraMe_object *pObjs, int objsLen,
 }
 
 /**
- * Collides a sprite against various sprites
+ * Get the sprite's hitbox padded by a pixel, so walls that it's only touching
+ * are still found (and separated)
  */
-void spr_collideAgainstSprGroup(sprite *pSpr, sprite **pSprs, int sprsLen,
-        int isSprFixed, int isSprsFixed) {
+static void spr_getPaddedBounds(int *pX, int *pY, int *pW, int *pH,
+        sprite *pSpr) {
+    spr_getBounds(pX, pY, pW, pH, pSpr);
+    *pX -= 1;
+    *pY -= 1;
+    *pW += 2;
+    *pH += 2;
+}
+
+/**
+ * Collides a sprite against every wall found by a broadphase
+ */
+static void spr_collideAgainstList(sprite *pSpr, GFraMe_object **ppWalls,
+        int len, int isSprFixed, int isWallsFixed) {
     GFraMe_collision_type mode;
-    GFraMe_object *pThisObj;
+    GFraMe_object *pObj;
     int i;
     
-    pThisObj = &(pSpr->pSelf->obj);
+    pObj = &(pSpr->pSelf->obj);
+    mode = spr_getCollisionMode(isSprFixed, isWallsFixed);
     
-    if (isSprFixed && isSprsFixed) {
-        mode = GFraMe_collision_full;
-    }
-    else if (isSprFixed) {
-        mode = GFraMe_first_fixed;
-    }
-    else if (isSprsFixed) {
-        mode = GFraMe_second_fixed;
-    }
-    else {
-        mode = GFraMe_dont_collide;
+    i = 0;
+    while (i < len) {
+        GFraMe_object_overlap(pObj, ppWalls[i], mode);
+        i++;
     }
+}
+
+/**
+ * Collides a sprite against the walls near it
+ */
+void spr_collideAgainstWalls(sprite *pSpr, wallGrid *pWg, int isSprFixed,
+        int isWallsFixed) {
+    GFraMe_object **ppWalls;
+    int h, len, w, x, y;
+    
+    spr_getPaddedBounds(&x, &y, &w, &h, pSpr);
+    wg_query(&ppWalls, &len, pWg, x, y, w, h);
+    spr_collideAgainstList(pSpr, ppWalls, len, isSprFixed, isWallsFixed);
+}
+
+/**
+ * Collides a sprite against the walls near it, found through a BVH
+ */
+void spr_collideAgainstBvh(sprite *pSpr, wallBvh *pBvh, int isSprFixed,
+        int isWallsFixed) {
+    GFraMe_object **ppWalls;
+    int h, len, w, x, y;
+    
+    spr_getPaddedBounds(&x, &y, &w, &h, pSpr);
+    bvh_queryBox(&ppWalls, &len, pBvh, x, y, w, h);
+    spr_collideAgainstList(pSpr, ppWalls, len, isSprFixed, isWallsFixed);
+}
+
+/**
+ * Collides a sprite against the solid tiles near it
+ */
+void spr_collideAgainstMap(sprite *pSpr, collMap *pCm, int isSprFixed,
+        int isWallsFixed) {
+    GFraMe_object **ppRuns;
+    int h, len, rv, w, x, y;
+    
+    spr_getPaddedBounds(&x, &y, &w, &h, pSpr);
+    rv = cm_getSolids(&ppRuns, &len, pCm, x, y, w, h);
+    ASSERT_NR(rv == 0);
+    spr_collideAgainstList(pSpr, ppRuns, len, isSprFixed, isWallsFixed);
+__ret:
+    return;
+}
+
+/**
+ * Returns whether the sprite's hitbox overlaps any tile with any of the flags
+ */
+int spr_overlapsMap(sprite *pSpr, collMap *pCm, int flags) {
+    int h, w, x, y;
+    
+    spr_getBounds(&x, &y, &w, &h, pSpr);
+    return cm_overlaps(pCm, x, y, w, h, flags);
+}
+
+/**
+ * Collides two sprites and, if they overlapped, calls their collision handler
+ */
+int spr_collideAgainstSpr(sprite *pSpr, sprite *pOther, int isSprFixed,
+        int isOtherFixed) {
+    GFraMe_collision_type mode;
+    GFraMe_ret rv;
+    
+    mode = spr_getCollisionMode(isSprFixed, isOtherFixed);
+    rv = GFraMe_object_overlap(&(pSpr->pSelf->obj), &(pOther->pSelf->obj),
+            mode);
+    if (rv != GFraMe_ret_ok)
+        return 0;
+    
+    collisionCallback(pSpr, pOther, pSpr->type, pOther->type);
+    return 1;
+}
+
+/**
+ * Collides a sprite against various sprites
+ */
+void spr_collideAgainstSprGroup(sprite *pSpr, sprite **pSprs, int sprsLen,
+        int isSprFixed, int isSprsFixed) {
+    int i;
     
     i = 0;
     while (i < sprsLen) {
         if (pSprs[i]->isActive) {
-            GFraMe_ret rv;
-            GFraMe_object *pOtherObj;
-            
-            pOtherObj = &(pSprs[i]->pSelf->obj);
-            
-            rv = GFraMe_object_overlap(pThisObj, pOtherObj, mode);
-            
-            if (rv == GFraMe_ret_ok) {
-                collisionCallback(pSpr, pSprs[i], pSpr->type, pSprs[i]->type);
-                if (!pSpr->isActive)
-                    break;
-            }
+            spr_collideAgainstSpr(pSpr, pSprs[i], isSprFixed, isSprsFixed);
+            if (!pSpr->isActive)
+                break;
         }
         
         i++;
@@ -444,6 +560,26 @@ int spr_isAlive(sprite *pSpr) {
     return pSpr->isActive;
 }
 
+/**
+ * Get the sprite's type
+ */
+sprType spr_getType(sprite *pSpr) {
+    return pSpr->type;
+}
+
+/**
+ * Get the sprite's hitbox, in world space
+ */
+void spr_getBounds(int *pX, int *pY, int *pW, int *pH, sprite *pSpr) {
+    GFraMe_object *pObj;
+    
+    pObj = &(pSpr->pSelf->obj);
+    *pX = pObj->x + pObj->hitbox.cx - pObj->hitbox.hw;
+    *pY = pObj->y + pObj->hitbox.cy - pObj->hitbox.hh;
+    *pW = pObj->hitbox.hw * 2;
+    *pH = pObj->hitbox.hh * 2;
+}
+
 /**
  * Modify the sprite's type
  */
@@ -10,6 +10,9 @@
 #include <GFraMe/GFraMe_sprite.h>
 
 #include "camera.h"
+#include "collmap.h"
+#include "wallbvh.h"
+#include "wallgrid.h"
 
 extern int _sprRedStoneData[];
 extern int _sprRedStoneAnimLen;
@@ -113,6 +116,12 @@ int spr_didChangeFrame(sprite *pSpr);
  */
 int spr_didAnimationFinish(sprite *pSpr);
 
+/**
+ * Get how much the camera must be offset so the sprite is rendered on its
+ * interpolated position (i.e., how far the sprite is ahead of it)
+ */
+void spr_getInterpOffset(int *pDx, int *pDy, sprite *pSpr, camera *pCam);
+
 /**
  * Draw the sprite
  */
@@ -139,6 +148,37 @@ int spr_isInsideCamera(sprite *pSpr, camera *pCam);
 void spr_collideAgainstGroup(sprite *pSpr, GFraMe_object *pObjs, int objsLen,
         int isSprFixed, int isObjsFixed);
 
+/**
+ * Collides a sprite against the walls on the cells its hitbox touches
+ */
+void spr_collideAgainstWalls(sprite *pSpr, wallGrid *pWg, int isSprFixed,
+        int isWallsFixed);
+
+/**
+ * Collides a sprite against the walls (on the BVH) that its hitbox overlaps
+ */
+void spr_collideAgainstBvh(sprite *pSpr, wallBvh *pBvh, int isSprFixed,
+        int isWallsFixed);
+
+/**
+ * Collides a sprite against the solid tiles that its hitbox overlaps
+ */
+void spr_collideAgainstMap(sprite *pSpr, collMap *pCm, int isSprFixed,
+        int isWallsFixed);
+
+/**
+ * Returns whether the sprite's hitbox overlaps any tile with any of the flags
+ */
+int spr_overlapsMap(sprite *pSpr, collMap *pCm, int flags);
+
+/**
+ * Collides two sprites and, if they overlapped, calls their collision handler
+ *
+ * @return Whether the sprites overlapped
+ */
+int spr_collideAgainstSpr(sprite *pSpr, sprite *pOther, int isSprFixed,
+        int isOtherFixed);
+
 /**
  * Collides a sprite against various sprites
  */
@@ -160,6 +200,16 @@ void spr_revive(sprite *pSpr);
  */
 int spr_isAlive(sprite *pSpr);
 
+/**
+ * Get the sprite's type
+ */
+sprType spr_getType(sprite *pSpr);
+
+/**
+ * Get the sprite's hitbox, in world space
+ */
+void spr_getBounds(int *pX, int *pY, int *pW, int *pH, sprite *pSpr);
+
 /**
  * Modify the sprite's type
  */
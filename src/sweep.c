@@ -0,0 +1,217 @@
+/**
+ * @file src/sweep.c
+ *
+ * Sweep-and-prune broadphase for sprite-vs-sprite collisions; Sprites are kept
+ * sorted along the horizontal axis, so only the ones whose extents overlap are
+ * ever tested against each other
+ *
+ * The order is kept between calls and fixed with an insertion sort, which is
+ * close to linear since sprites barely move from one frame to the next
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "sprite.h"
+#include "sweep.h"
+
+/** A sprite and its bounds, as of the last sort */
+struct stSapEntry {
+    /** The sprite (not owned) */
+    sprite *pSpr;
+    /** The sprite's sapGroup */
+    int group;
+    /** The sapGroups that the sprite collides against */
+    int mask;
+    /** Whether the sprite shouldn't be moved on collision */
+    int isFixed;
+    /** Left side, in world space */
+    int minX;
+    /** Right side, in world space */
+    int maxX;
+    /** Top side, in world space */
+    int minY;
+    /** Bottom side, in world space */
+    int maxY;
+};
+
+/** 'Export' the sweep-and-prune structure */
+struct stSweepPrune {
+    /** Every sprite, sorted by its left side */
+    struct stSapEntry *pEntries;
+    /** How many entries there are in use */
+    int entriesUsed;
+    /** How many entries there are allocated */
+    int entriesLen;
+};
+
+/**
+ * Alloc a new sweep-and-prune structure
+ */
+int sap_getNew(sweepPrune **ppSap) {
+    int rv;
+    
+    // Check params
+    ASSERT(ppSap, 1);
+    ASSERT(!(*ppSap), 1);
+    
+    // Alloc the structure
+    *ppSap = (sweepPrune*)malloc(sizeof(sweepPrune));
+    ASSERT(*ppSap, 1);
+    
+    // Clean every variable
+    memset(*ppSap, 0, sizeof(sweepPrune));
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Free a sweep-and-prune structure's memory
+ */
+void sap_free(sweepPrune **ppSap) {
+    // Check params
+    ASSERT_NR(ppSap);
+    ASSERT_NR(*ppSap);
+    
+    if ((*ppSap)->pEntries)
+        free((*ppSap)->pEntries);
+    
+    // Free the structure
+    free(*ppSap);
+    *ppSap = 0;
+    
+__ret:
+    return;
+}
+
+/**
+ * Remove every sprite
+ */
+void sap_clear(sweepPrune *pSap) {
+    pSap->entriesUsed = 0;
+}
+
+/**
+ * Add a sprite; Adding a sprite that was already added does nothing
+ */
+int sap_add(sweepPrune *pSap, sprite *pSpr, int group, int mask, int isFixed) {
+    struct stSapEntry *pEntry;
+    int i, rv;
+    
+    // Check the arguments
+    ASSERT(pSap, 1);
+    ASSERT(pSpr, 1);
+    
+    i = 0;
+    while (i < pSap->entriesUsed) {
+        if (pSap->pEntries[i].pSpr == pSpr)
+            return 0;
+        i++;
+    }
+    
+    // Expand the entries, if needed
+    if (pSap->entriesUsed >= pSap->entriesLen) {
+        pSap->entriesLen += 8;
+        pSap->pEntries = (struct stSapEntry*)realloc(pSap->pEntries,
+                sizeof(struct stSapEntry) * pSap->entriesLen);
+        ASSERT(pSap->pEntries, 1);
+    }
+    
+    // It's sorted into place on the next sap_collide
+    pEntry = &pSap->pEntries[pSap->entriesUsed];
+    pEntry->pSpr = pSpr;
+    pEntry->group = group;
+    pEntry->mask = mask;
+    pEntry->isFixed = isFixed;
+    pEntry->minX = 0;
+    pEntry->maxX = 0;
+    pEntry->minY = 0;
+    pEntry->maxY = 0;
+    pSap->entriesUsed++;
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Update every entry's bounds and sort them by their left side
+ */
+static void sap_sort(sweepPrune *pSap) {
+    struct stSapEntry *pEntries;
+    int i;
+    
+    pEntries = pSap->pEntries;
+    
+    i = 0;
+    while (i < pSap->entriesUsed) {
+        int h, w;
+        
+        spr_getBounds(&pEntries[i].minX, &pEntries[i].minY, &w, &h,
+                pEntries[i].pSpr);
+        pEntries[i].maxX = pEntries[i].minX + w;
+        pEntries[i].maxY = pEntries[i].minY + h;
+        i++;
+    }
+    
+    // Insertion sort, as the entries should already be (nearly) in order
+    i = 1;
+    while (i < pSap->entriesUsed) {
+        struct stSapEntry tmp;
+        int j;
+        
+        tmp = pEntries[i];
+        j = i - 1;
+        while (j >= 0 && pEntries[j].minX > tmp.minX) {
+            pEntries[j + 1] = pEntries[j];
+            j--;
+        }
+        pEntries[j + 1] = tmp;
+        i++;
+    }
+}
+
+/**
+ * Sort the sprites by their current position and collide every overlapping
+ * pair whose groups match
+ */
+void sap_collide(sweepPrune *pSap) {
+    struct stSapEntry *pEntries;
+    int i;
+    
+    sap_sort(pSap);
+    pEntries = pSap->pEntries;
+    
+    // Bounds aren't updated as pairs are separated; Those moves are small and
+    // are picked up on the next call
+    i = 0;
+    while (i < pSap->entriesUsed) {
+        struct stSapEntry *pA;
+        int j;
+        
+        pA = &pEntries[i];
+        j = i + 1;
+        // Stop on the first sprite that starts after this one ends
+        while (spr_isAlive(pA->pSpr) && j < pSap->entriesUsed
+                && pEntries[j].minX <= pA->maxX) {
+            struct stSapEntry *pB;
+            
+            pB = &pEntries[j];
+            j++;
+            
+            if (!(pA->mask & pB->group) && !(pB->mask & pA->group))
+                continue;
+            if (pA->minY > pB->maxY || pB->minY > pA->maxY)
+                continue;
+            if (!spr_isAlive(pB->pSpr))
+                continue;
+            
+            spr_collideAgainstSpr(pA->pSpr, pB->pSpr, pA->isFixed,
+                    pB->isFixed);
+        }
+        i++;
+    }
+}
+
@@ -0,0 +1,56 @@
+/**
+ * @file src/sweep.h
+ *
+ * Sweep-and-prune broadphase for sprite-vs-sprite collisions; Sprites are kept
+ * sorted along the horizontal axis, so only the ones whose extents overlap are
+ * ever tested against each other
+ */
+#ifndef __SWEEP_H__
+#define __SWEEP_H__
+
+#include "sprite.h"
+
+/** 'Export' the sweep-and-prune structure */
+typedef struct stSweepPrune sweepPrune;
+
+/** Groups that a sprite may belong to (and collide against) */
+typedef enum {
+    SAP_PLAYER    = 0x01,
+    SAP_STONE     = 0x02,
+    SAP_PL_BULLET = 0x04
+} sapGroup;
+
+/**
+ * Alloc a new sweep-and-prune structure
+ */
+int sap_getNew(sweepPrune **ppSap);
+
+/**
+ * Free a sweep-and-prune structure's memory
+ */
+void sap_free(sweepPrune **ppSap);
+
+/**
+ * Remove every sprite
+ */
+void sap_clear(sweepPrune *pSap);
+
+/**
+ * Add a sprite; Adding a sprite that was already added does nothing
+ *
+ * The sprite isn't copied, so it must be kept valid (even while dead, as dead
+ * sprites are only skipped) until the structure is cleared
+ *
+ * @param group The sprite's sapGroup
+ * @param mask Every sapGroup that the sprite collides against
+ */
+int sap_add(sweepPrune *pSap, sprite *pSpr, int group, int mask, int isFixed);
+
+/**
+ * Sort the sprites by their current position and collide every overlapping
+ * pair whose groups match (through collisionCallback)
+ */
+void sap_collide(sweepPrune *pSap);
+
+#endif /* __SWEEP_H__ */
+
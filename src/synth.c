@@ -0,0 +1,328 @@
+/**
+ * @file src/synth.c
+ * 
+ * Synthesizer that renders a compiled MML song on the fly, with a square,
+ * triangle or noise oscillator (and an amplitude envelope) per track
+ * 
+ * Events and envelopes only change on tick boundaries, so samples are rendered
+ * in runs of constant amplitude; Within a run, the square and triangle
+ * oscillators compute each sample's phase directly from its index, so their
+ * loops have no dependency between iterations and may be vectorized by the
+ * compiler (the noise's shift register is inherently sequential)
+ */
+#include <SDL2/SDL_stdinc.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "mml.h"
+#include "synth.h"
+
+/** A track being played */
+struct stSynChannel {
+    /** First event on the track */
+    mmlEvent *pTrack;
+    /** Next event to be played */
+    mmlEvent *pEv;
+    /** Current parameters */
+    int wave;
+    int volume;
+    int quant;
+    int table;
+    /** Ticks until the next event */
+    int ticksLeft;
+    /** Ticks until the current note is released */
+    int gateLeft;
+    /** Ticks since the note started (indexes the envelope) */
+    int envPos;
+    /** Current amplitude (0 while silent) */
+    int amp;
+    /** Oscillator's phase and how much it advances per sample */
+    Uint32 phase;
+    Uint32 step;
+    /** Noise's shift register */
+    Uint32 lfsr;
+    /** Whether the track ended (it's restarted once every track ends) */
+    int isDone;
+};
+typedef struct stSynChannel synChannel;
+
+/** The song being played */
+static mmlSong *_synSong = 0;
+/** A channel per track */
+static synChannel *_synChannels = 0;
+/** Sample rate */
+static int _synFreq = 0;
+/** Whether the song is restarted after it ends */
+static int _synDoLoop = 0;
+/** Ticks played so far */
+static Uint32 _synTick = 0;
+/** Samples left on the current tick */
+static int _synTickLeft = 0;
+/** Oscillator's step for each note */
+static Uint32 _synSteps[128];
+/** Channels are accumulated here before being clamped */
+static Sint32 _synMix[SYN_BLOCK_LEN];
+
+/**
+ * Get the first sample of a tick; Computed from the very first tick, so
+ * rounding errors don't accumulate
+ */
+static Uint64 syn_getTickSample(Uint32 tick) {
+    // There are 4 quarter notes in a whole and 60 seconds in a minute
+    return (Uint64)tick * _synFreq * 240 / ((Uint64)_synSong->tempo *
+            MML_TICKS);
+}
+
+/**
+ * Play every event that starts on this tick and update the amplitude
+ */
+static void syn_tickChannel(synChannel *pCh) {
+    while (pCh->ticksLeft == 0 && !pCh->isDone) {
+        mmlEvent *pEv;
+        
+        pEv = pCh->pEv;
+        pCh->pEv++;
+        switch (pEv->type) {
+            case MML_EV_NOTE: {
+                pCh->step = _synSteps[pEv->arg];
+                pCh->ticksLeft = pEv->len;
+                pCh->gateLeft = pEv->len * pCh->quant / 8;
+                if (pCh->gateLeft == 0)
+                    pCh->gateLeft = 1;
+                pCh->envPos = 0;
+            } break;
+            case MML_EV_REST: {
+                pCh->ticksLeft = pEv->len;
+                pCh->gateLeft = 0;
+            } break;
+            case MML_EV_WAVE: pCh->wave = pEv->arg; break;
+            case MML_EV_VOLUME: pCh->volume = pEv->arg; break;
+            case MML_EV_ENVELOPE: pCh->table = pEv->arg; break;
+            case MML_EV_QUANT: pCh->quant = pEv->arg; break;
+            case MML_EV_END: {
+                pCh->isDone = 1;
+                pCh->gateLeft = 0;
+            } break;
+        }
+    }
+    
+    if (pCh->gateLeft > 0) {
+        mmlTable *pTable;
+        int env;
+        
+        // Without an envelope, notes are played at full amplitude
+        pTable = &_synSong->pTables[pCh->table];
+        if (pTable->len == 0)
+            env = 128;
+        else if (pCh->envPos < pTable->len)
+            env = pTable->pValues[pCh->envPos];
+        else
+            env = pTable->pValues[pTable->len - 1];
+        
+        pCh->amp = pCh->volume * env * SYN_CHANNEL_AMP / (15 * 128);
+        pCh->gateLeft--;
+        pCh->envPos++;
+    }
+    else
+        pCh->amp = 0;
+    
+    if (!pCh->isDone)
+        pCh->ticksLeft--;
+}
+
+/**
+ * Advance the song by a tick
+ */
+static void syn_tick() {
+    int i, isDone;
+    
+    isDone = 1;
+    i = 0;
+    while (i < _synSong->tracksLen) {
+        syn_tickChannel(&_synChannels[i]);
+        isDone = isDone && _synChannels[i].isDone;
+        i++;
+    }
+    
+    // Restart every track together, once the longest one ends, so they are
+    // kept in sync
+    if (isDone && _synDoLoop) {
+        i = 0;
+        while (i < _synSong->tracksLen) {
+            _synChannels[i].pEv = _synChannels[i].pTrack;
+            _synChannels[i].isDone = 0;
+            syn_tickChannel(&_synChannels[i]);
+            i++;
+        }
+    }
+    
+    _synTickLeft = (int)(syn_getTickSample(_synTick + 1) -
+            syn_getTickSample(_synTick));
+    _synTick++;
+}
+
+/**
+ * Add a channel's next samples to the mix
+ */
+static void syn_renderChannel(synChannel *pCh, int len) {
+    Uint32 phase, step;
+    Sint32 amp;
+    int i;
+    
+    phase = pCh->phase;
+    step = pCh->step;
+    amp = pCh->amp;
+    
+    i = 0;
+    switch (pCh->wave) {
+        case MML_WAVE_SQUARE: {
+            while (i < len) {
+                Sint32 sign;
+                
+                // -1 on the second half of the period and 1 on the first
+                sign = ((Sint32)(phase + step * (Uint32)i) >> 31) | 1;
+                _synMix[i] += sign * amp;
+                i++;
+            }
+        } break;
+        case MML_WAVE_TRIANGLE: {
+            while (i < len) {
+                Sint32 pos, tri;
+                
+                // Fold the phase, so it rises and then falls (0 to 65535)
+                pos = (Sint32)(phase + step * (Uint32)i);
+                tri = (pos ^ (pos >> 31)) >> 15;
+                _synMix[i] += ((tri - 32768) * amp) >> 15;
+                i++;
+            }
+        } break;
+        case MML_WAVE_NOISE: {
+            Uint32 lfsr, pos;
+            
+            // The register is clocked faster than the note's pitch
+            if (step < 0x10000000)
+                step <<= 4;
+            else
+                step = 0xffffffff;
+            
+            lfsr = pCh->lfsr;
+            pos = phase;
+            while (i < len) {
+                pos += step;
+                if (pos < step)
+                    lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xb400);
+                _synMix[i] += (lfsr & 1) ? amp : -amp;
+                i++;
+            }
+            pCh->lfsr = lfsr;
+            pCh->phase = pos;
+        } return;
+    }
+    
+    pCh->phase = phase + step * (Uint32)len;
+}
+
+/**
+ * Start playing a song from its beginning; The song isn't copied, so it must
+ * be kept valid until syn_clean
+ */
+int syn_init(mmlSong *pSong, int freq, int doLoop) {
+    int i, rv;
+    
+    syn_clean();
+    
+    _synChannels = (synChannel*)malloc(sizeof(synChannel) * pSong->tracksLen);
+    ASSERT(_synChannels, 1);
+    memset(_synChannels, 0x0, sizeof(synChannel) * pSong->tracksLen);
+    
+    i = 0;
+    while (i < pSong->tracksLen) {
+        synChannel *pCh;
+        
+        pCh = &_synChannels[i];
+        pCh->pTrack = pSong->ppTracks[i];
+        pCh->pEv = pCh->pTrack;
+        pCh->wave = MML_WAVE_SQUARE;
+        pCh->volume = 8;
+        pCh->quant = 8;
+        pCh->lfsr = 1;
+        i++;
+    }
+    
+    // Note 57 is A4 (440 Hz); Anything above Nyquist is clamped to it
+    i = 0;
+    while (i < 128) {
+        double step;
+        
+        step = 440.0 * pow(2.0, (i - 57) / 12.0) / freq * 4294967296.0;
+        if (step > 2147483647.0)
+            step = 2147483647.0;
+        _synSteps[i] = (Uint32)step;
+        i++;
+    }
+    
+    _synSong = pSong;
+    _synFreq = freq;
+    _synDoLoop = doLoop;
+    _synTick = 0;
+    _synTickLeft = 0;
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Render the next samples (signed 16 bits, mono)
+ */
+void syn_render(Sint16 *pDst, int len) {
+    while (len > 0) {
+        int i, num;
+        
+        if (_synTickLeft == 0)
+            syn_tick();
+        
+        num = len;
+        if (num > _synTickLeft)
+            num = _synTickLeft;
+        if (num > SYN_BLOCK_LEN)
+            num = SYN_BLOCK_LEN;
+        
+        memset(_synMix, 0x0, sizeof(Sint32) * num);
+        i = 0;
+        while (i < _synSong->tracksLen) {
+            if (_synChannels[i].amp != 0)
+                syn_renderChannel(&_synChannels[i], num);
+            i++;
+        }
+        
+        i = 0;
+        while (i < num) {
+            Sint32 val;
+            
+            val = _synMix[i];
+            val = (val > 32767) ? 32767 : val;
+            val = (val < -32768) ? -32768 : val;
+            pDst[i] = (Sint16)val;
+            i++;
+        }
+        
+        pDst += num;
+        len -= num;
+        _synTickLeft -= num;
+    }
+}
+
+/**
+ * Release the synthesizer's memory
+ */
+void syn_clean() {
+    if (_synChannels)
+        free(_synChannels);
+    _synChannels = 0;
+    _synSong = 0;
+}
+
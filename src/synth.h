@@ -0,0 +1,35 @@
+/**
+ * @file src/synth.h
+ * 
+ * Synthesizer that renders a compiled MML song on the fly, with a square,
+ * triangle or noise oscillator (and an amplitude envelope) per track
+ */
+#ifndef __SYNTH_H__
+#define __SYNTH_H__
+
+#include <SDL2/SDL_stdinc.h>
+
+#include "mml.h"
+
+/**
+ * Start playing a song from its beginning; The song isn't copied, so it must
+ * be kept valid until syn_clean
+ * 
+ * @param freq Sample rate of the rendered audio
+ * @param doLoop Whether the song restarts after it ends
+ * @return 0 on success
+ */
+int syn_init(mmlSong *pSong, int freq, int doLoop);
+
+/**
+ * Render the next samples (signed 16 bits, mono)
+ */
+void syn_render(Sint16 *pDst, int len);
+
+/**
+ * Release the synthesizer's memory
+ */
+void syn_clean();
+
+#endif /* __SYNTH_H__ */
+
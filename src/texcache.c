@@ -0,0 +1,194 @@
+/**
+ * @file src/texcache.c
+ * 
+ * Cache of decoded textures, stored in the format expected by
+ * GFraMe_texture_load; It's written the first time a texture is decoded and
+ * memory-mapped on every following run
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+#include "global.h"
+#include "texcache.h"
+
+/** Identifies a cache file (and its version) */
+#define TC_MAGIC 0x31435447 // "GTC1"
+
+/** Cache's header; The pixels follow it */
+struct stTexCacheHeader {
+    /** Must be TC_MAGIC */
+    unsigned int magic;
+    /** Texture's width */
+    unsigned int width;
+    /** Texture's height */
+    unsigned int height;
+    /** Bytes per pixel */
+    unsigned int bpp;
+    /** Size of the bitmap it was decoded from */
+    unsigned int srcSize;
+    /** Modification time of the bitmap it was decoded from */
+    unsigned int srcTime;
+    /** Pad the header to 32 bytes, so the pixels are aligned */
+    unsigned int padding[2];
+};
+typedef struct stTexCacheHeader texCacheHeader;
+
+/**
+ * Fill a header for the texture; Fails if its bitmap can't be found
+ */
+static int tc_getHeader(texCacheHeader *pHdr, char *pName, int width,
+        int height) {
+    struct stat st;
+    char pPath[512];
+    int rv;
+    
+    rv = gl_getAssetPath(pPath, sizeof(pPath), pName, "bmp");
+    ASSERT(rv == 0, 1);
+    ASSERT(stat(pPath, &st) == 0, 1);
+    
+    memset(pHdr, 0x0, sizeof(texCacheHeader));
+    pHdr->magic = TC_MAGIC;
+    pHdr->width = width;
+    pHdr->height = height;
+    pHdr->bpp = TEXBPP;
+    pHdr->srcSize = (unsigned int)st.st_size;
+    pHdr->srcTime = (unsigned int)st.st_mtime;
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Map a texture's cache into memory; Fails if there's no cache or if it's
+ * older than the texture's bitmap
+ */
+int tc_load(unsigned char **ppData, char *pName, int width, int height) {
+    texCacheHeader expected, *pHdr;
+    unsigned char *pMem;
+    char pPath[512];
+    size_t len;
+    int fd, rv;
+    
+    fd = -1;
+    pMem = 0;
+    len = sizeof(texCacheHeader) + width * height * TEXBPP;
+    
+    rv = tc_getHeader(&expected, pName, width, height);
+    ASSERT(rv == 0, 1);
+    rv = gl_getAssetPath(pPath, sizeof(pPath), pName, "cache");
+    ASSERT(rv == 0, 1);
+    
+#ifndef _WIN32
+    {
+        struct stat st;
+        
+        fd = open(pPath, O_RDONLY);
+        ASSERT(fd >= 0, 1);
+        // Mapping past the end of the file would crash on access
+        ASSERT(fstat(fd, &st) == 0 && (size_t)st.st_size == len, 1);
+    }
+    pMem = (unsigned char*)mmap(0, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (pMem == MAP_FAILED)
+        pMem = 0;
+    ASSERT(pMem, 1);
+#else
+    {
+        FILE *pFp;
+        
+        pFp = fopen(pPath, "rb");
+        ASSERT(pFp, 1);
+        pMem = (unsigned char*)malloc(len);
+        if (pMem && fread(pMem, len, 1, pFp) != 1) {
+            free(pMem);
+            pMem = 0;
+        }
+        fclose(pFp);
+        ASSERT(pMem, 1);
+    }
+#endif
+    
+    // Check that it was generated from the current bitmap
+    pHdr = (texCacheHeader*)pMem;
+    ASSERT(memcmp(pHdr, &expected, sizeof(texCacheHeader)) == 0, 1);
+    
+    *ppData = pMem + sizeof(texCacheHeader);
+    pMem = 0;
+    rv = 0;
+__ret:
+    if (pMem) {
+#ifndef _WIN32
+        munmap(pMem, len);
+#else
+        free(pMem);
+#endif
+    }
+#ifndef _WIN32
+    // The mapping is kept even after the file is closed
+    if (fd >= 0)
+        close(fd);
+#endif
+    
+    return rv;
+}
+
+/**
+ * Write a decoded texture to its cache; Failing to do so (e.g., because the
+ * assets are on a read-only directory) is silently ignored
+ */
+void tc_save(unsigned char *pData, char *pName, int width, int height) {
+    texCacheHeader hdr;
+    char pPath[512];
+    FILE *pFp;
+    int rv;
+    
+    pFp = 0;
+    
+    rv = tc_getHeader(&hdr, pName, width, height);
+    ASSERT_NR(rv == 0);
+    rv = gl_getAssetPath(pPath, sizeof(pPath), pName, "cache");
+    ASSERT_NR(rv == 0);
+    
+    pFp = fopen(pPath, "wb");
+    ASSERT_NR(pFp);
+    
+    rv = fwrite(&hdr, sizeof(texCacheHeader), 1, pFp) == 1 &&
+            fwrite(pData, width * height * TEXBPP, 1, pFp) == 1;
+    fclose(pFp);
+    pFp = 0;
+    
+    // Don't leave a truncated cache behind
+    if (!rv)
+        remove(pPath);
+__ret:
+    if (pFp)
+        fclose(pFp);
+}
+
+/**
+ * Release pixels retrieved by tc_load
+ */
+void tc_free(unsigned char **ppData, int width, int height) {
+    unsigned char *pMem;
+    
+    ASSERT_NR(ppData);
+    ASSERT_NR(*ppData);
+    
+    pMem = *ppData - sizeof(texCacheHeader);
+#ifndef _WIN32
+    munmap(pMem, sizeof(texCacheHeader) + width * height * TEXBPP);
+#else
+    free(pMem);
+#endif
+    *ppData = 0;
+__ret:
+    return;
+}
+
@@ -0,0 +1,33 @@
+/**
+ * @file src/texcache.h
+ * 
+ * Cache of decoded textures, stored in the format expected by
+ * GFraMe_texture_load; It's written the first time a texture is decoded and
+ * memory-mapped on every following run
+ */
+#ifndef __TEXCACHE_H__
+#define __TEXCACHE_H__
+
+/**
+ * Map a texture's cache into memory; Fails if there's no cache or if it's
+ * older than the texture's bitmap
+ * 
+ * @param ppData The mapped pixels (must be released with tc_free)
+ * @param pName The texture's name (as passed to GFraMe_assets_buffer_image)
+ * @return 0 on success
+ */
+int tc_load(unsigned char **ppData, char *pName, int width, int height);
+
+/**
+ * Write a decoded texture to its cache; Failing to do so (e.g., because the
+ * assets are on a read-only directory) is silently ignored
+ */
+void tc_save(unsigned char *pData, char *pName, int width, int height);
+
+/**
+ * Release pixels retrieved by tc_load
+ */
+void tc_free(unsigned char **ppData, int width, int height);
+
+#endif /* __TEXCACHE_H__ */
+
@@ -3,15 +3,29 @@
  * 
  * Renders a text in a character-by-character manner
  */
+#include <GFraMe/GFraMe_error.h>
 #include <GFraMe/GFraMe_spriteset.h>
+#include <GFraMe/GFraMe_texture.h>
 
 #include <stdlib.h>
 #include <string.h>
 
 #include "audio.h"
+#include "draw.h"
 #include "global.h"
 #include "text.h"
 
+/** A character already laid out on the window */
+struct stGlyph {
+    /** Tile on the atlas */
+    int tile;
+    /** Horizontal position, in pixels */
+    int x;
+    /** Line where the glyph is */
+    int line;
+};
+typedef struct stGlyph glyph;
+
 struct stText {
     char *curText;
     int length;
@@ -19,8 +33,31 @@ struct stText {
     int maxLength;
     int numLines;
     int didFinish;
+    /** Pre-rendered window (the same for every text) */
+    GFraMe_texture winTex;
+    GFraMe_spriteset winSset;
+    int isWinCached;
+    /** Every glyph on the current text */
+    glyph *pGlyphs;
+    int glyphsLen;
+    /** How many glyphs are revealed for a given length (maxLength+1 items) */
+    int *pGlyphCount;
+    int glyphCountLen;
+    /** Index of the first glyph on each line */
+    int *pLineStart;
+    int lineStartLen;
 };
 
+/** Window's position and dimensions, in pixels */
+#define TXT_WIN_X 0
+#define TXT_WIN_Y 16
+#define TXT_WIN_W SCRW
+#define TXT_WIN_H (5*8)
+
+static int txt_compile(text *pTxt);
+static void txt_cacheWindow(text *pTxt);
+static void txt_drawWindowTiles();
+
 static char _str_line0[] = 
 "MOVE WITH AD, QD OR THE LEFT STICK\n"
 "JUMP WITH THE SPACEBAR OR THE \n"
@@ -80,6 +117,14 @@ void txt_free(text **ppTxt) {
     ASSERT_NR(ppTxt);
     ASSERT_NR(*ppTxt);
     
+    if ((*ppTxt)->isWinCached)
+        GFraMe_texture_clear(&(*ppTxt)->winTex);
+    if ((*ppTxt)->pGlyphs)
+        free((*ppTxt)->pGlyphs);
+    if ((*ppTxt)->pGlyphCount)
+        free((*ppTxt)->pGlyphCount);
+    if ((*ppTxt)->pLineStart)
+        free((*ppTxt)->pLineStart);
     free(*ppTxt);
     *ppTxt = 0;
 __ret:
@@ -88,7 +133,15 @@ __ret:
 
 void txt_setText(text *pTxt, int num) {
     // Clean up the text
-    memset(pTxt, 0, sizeof(text));
+    pTxt->curText = 0;
+    pTxt->length = 0;
+    pTxt->cooldown = 0;
+    pTxt->maxLength = 0;
+    pTxt->didFinish = 0;
+    
+    // Render the window, if it wasn't done yet
+    if (!pTxt->isWinCached)
+        txt_cacheWindow(pTxt);
     
     switch (num) {
         case 0: {
@@ -105,6 +158,10 @@ void txt_setText(text *pTxt, int num) {
         } break;
     }
     pTxt->numLines = 1;
+    
+    // Lay out every glyph
+    if (pTxt->curText && txt_compile(pTxt) != 0)
+        pTxt->curText = 0;
 }
 
 void txt_update(text *pTxt, int ms) {
@@ -142,80 +199,194 @@ void txt_update(text *pTxt, int ms) {
 }
 
 void txt_draw(text *pTxt) {
-    int i, lines, x, y;
-    int tile;
+    int i, end, firstLine;
     
     if (!pTxt->curText) {
         return;
     }
     
-    x = 8;
-    y = 24;
-    
     // Draw the window (on the BG)
+    if (pTxt->isWinCached)
+        drw_tile(&pTxt->winSset, &pTxt->winTex, 0, TXT_WIN_X, TXT_WIN_Y,
+                0/*flipped*/, DRW_LAYER_TEXT_BG);
+    else
+        txt_drawWindowTiles();
     
-    // Draw the center
+    // Only the last lines are visible
+    firstLine = pTxt->numLines - TXT_MAX_LINES;
+    if (firstLine < 0)
+        firstLine = 0;
+    
+    // Draw the text
+    i = pTxt->pLineStart[firstLine];
+    end = pTxt->pGlyphCount[pTxt->length];
+    while (i < end) {
+        glyph *pGlyph;
+        
+        pGlyph = &pTxt->pGlyphs[i];
+        drw_tile(gl_sset8x8, gl_tex, pGlyph->tile, pGlyph->x,
+                24 + (pGlyph->line - firstLine) * 8, 0/*flipped*/,
+                DRW_LAYER_TEXT);
+        i++;
+    }
+}
+
+/**
+ * Lay out the current text into glyphs, so drawing it doesn't require parsing
+ * the string
+ */
+static int txt_compile(text *pTxt) {
+    int i, line, num, rv, x;
+    
+    // Expand the buffers, if needed (there are at most maxLength glyphs and
+    // lines)
+    if (pTxt->glyphsLen < pTxt->maxLength) {
+        pTxt->pGlyphs = (glyph*)realloc(pTxt->pGlyphs,
+                sizeof(glyph) * pTxt->maxLength);
+        ASSERT(pTxt->pGlyphs, 1);
+        pTxt->glyphsLen = pTxt->maxLength;
+    }
+    if (pTxt->glyphCountLen < pTxt->maxLength + 1) {
+        pTxt->pGlyphCount = (int*)realloc(pTxt->pGlyphCount,
+                sizeof(int) * (pTxt->maxLength + 1));
+        ASSERT(pTxt->pGlyphCount, 1);
+        pTxt->glyphCountLen = pTxt->maxLength + 1;
+    }
+    if (pTxt->lineStartLen < pTxt->maxLength + 1) {
+        pTxt->pLineStart = (int*)realloc(pTxt->pLineStart,
+                sizeof(int) * (pTxt->maxLength + 1));
+        ASSERT(pTxt->pLineStart, 1);
+        pTxt->lineStartLen = pTxt->maxLength + 1;
+    }
+    
+    x = 8;
+    line = 0;
+    num = 0;
+    pTxt->pLineStart[0] = 0;
     i = 0;
-    tile = 114;
-    while (i < (SCRW-8)*4) {
-        int j, k;
+    while (i < pTxt->maxLength) {
+        pTxt->pGlyphCount[i] = num;
         
-        j = i % (SCRW-8);
-        k = i / (SCRW-8);
-        GFraMe_spriteset_draw(gl_sset8x8, tile, x-8 + j*8, y-8 + k*8, 0/*flipped*/);
+        if (pTxt->curText[i] == '\n') {
+            x = 8;
+            line++;
+            pTxt->pLineStart[line] = num;
+        }
+        else {
+            // Spaces only advance the position
+            if (pTxt->curText[i] != ' ') {
+                pTxt->pGlyphs[num].tile = TL_FONT + pTxt->curText[i] - '!';
+                pTxt->pGlyphs[num].x = x;
+                pTxt->pGlyphs[num].line = line;
+                num++;
+            }
+            x += 8;
+        }
         i++;
     }
+    pTxt->pGlyphCount[i] = num;
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Render the window's tiles into a texture, so it's drawn with a single blit
+ */
+static void txt_cacheWindow(text *pTxt) {
+    unsigned char *pPixels;
+    GFraMe_ret rv;
+    int i, j;
+    
+    pPixels = (unsigned char*)malloc(TXT_WIN_W * TXT_WIN_H * TEXBPP);
+    ASSERT_NR(pPixels);
+    memset(pPixels, 0x0, TXT_WIN_W * TXT_WIN_H * TEXBPP);
+    
+    // Draw the center
+    j = 0;
+    while (j < 4) {
+        i = 0;
+        while (i < TXT_WIN_W / 8) {
+            gl_copyTile(pPixels, TXT_WIN_W, TL_WIN_CENTER, i*8, j*8);
+            i++;
+        }
+        j++;
+    }
     // Draw the top and bottom lines
     i = 0;
-    while (i < SCRW/8) {
-        tile = 82;
-        GFraMe_spriteset_draw(gl_sset8x8, tile, x-8 + i*8, y-8, 0/*flipped*/);
-        tile = 146;
-        GFraMe_spriteset_draw(gl_sset8x8, tile, x-8 + i*8, y-8 + 4*8, 0/*flipped*/);
+    while (i < TXT_WIN_W / 8) {
+        gl_copyTile(pPixels, TXT_WIN_W, TL_WIN_TOP, i*8, 0);
+        gl_copyTile(pPixels, TXT_WIN_W, TL_WIN_BOT, i*8, 4*8);
         i++;
     }
     // Draw the lateral lines
     i = 0;
     while (i < 5) {
-        tile = 113;
-        GFraMe_spriteset_draw(gl_sset8x8, tile, x-8, y-8 + i*8, 0/*flipped*/);
-        tile = 115;
-        GFraMe_spriteset_draw(gl_sset8x8, tile, x-8 + SCRW-8, y-8 + i*8, 0/*flipped*/);
+        gl_copyTile(pPixels, TXT_WIN_W, TL_WIN_LEFT, 0, i*8);
+        gl_copyTile(pPixels, TXT_WIN_W, TL_WIN_RIGHT, TXT_WIN_W-8, i*8);
         i++;
     }
-    
     // Draw the corners
-    tile = 81;
-    GFraMe_spriteset_draw(gl_sset8x8, tile, x-8, y-8, 0/*flipped*/);
-    tile = 83;
-    GFraMe_spriteset_draw(gl_sset8x8, tile, x-8 + SCRW-8, y-8, 0/*flipped*/);
-    tile = 145;
-    GFraMe_spriteset_draw(gl_sset8x8, tile, x-8, y-8 + 4*8, 0/*flipped*/);
-    tile = 147;
-    GFraMe_spriteset_draw(gl_sset8x8, tile, x-8 + SCRW-8, y-8 + 4*8, 0/*flipped*/);
+    gl_copyTile(pPixels, TXT_WIN_W, TL_WIN_TOP_LEFT, 0, 0);
+    gl_copyTile(pPixels, TXT_WIN_W, TL_WIN_TOP_RIGHT, TXT_WIN_W-8, 0);
+    gl_copyTile(pPixels, TXT_WIN_W, TL_WIN_BOT_LEFT, 0, 4*8);
+    gl_copyTile(pPixels, TXT_WIN_W, TL_WIN_BOT_RIGHT, TXT_WIN_W-8, 4*8);
     
-    i = 0;
-    lines = pTxt->numLines - TXT_MAX_LINES;
+    // Upload it
+    GFraMe_texture_init(&pTxt->winTex);
+    rv = GFraMe_texture_load(&pTxt->winTex, TXT_WIN_W, TXT_WIN_H, pPixels);
+    ASSERT_NR(rv == GFraMe_ret_ok);
+    GFraMe_spriteset_init(&pTxt->winSset, &pTxt->winTex, TXT_WIN_W, TXT_WIN_H);
+    pTxt->isWinCached = 1;
+__ret:
+    if (pPixels)
+        free(pPixels);
+}
+
+/**
+ * Draw the window tile by tile (used only if it couldn't be cached)
+ */
+static void txt_drawWindowTiles() {
+    int i, j;
     
-    // Draw the text
-    while (i < pTxt->length) {
-        
-        tile = pTxt->curText[i] - '!';
-        
-        if (pTxt->curText[i] != '\n' && lines <= 0) {
-            // Draw the current tile
-            GFraMe_spriteset_draw(gl_sset8x8, tile, x, y, 0/*flipped*/);
-            
-            x += 8;
-        }
-        else if (pTxt->curText[i] == '\n') {
-            if (lines <= 0) {
-                x = 8;
-                y += 8;
-            }
-            lines--;
+    // Draw the center
+    j = 0;
+    while (j < 4) {
+        i = 0;
+        while (i < TXT_WIN_W / 8) {
+            drw_tile(gl_sset8x8, gl_tex, TL_WIN_CENTER, TXT_WIN_X + i*8,
+                    TXT_WIN_Y + j*8, 0/*flipped*/, DRW_LAYER_TEXT_BG);
+            i++;
         }
+        j++;
+    }
+    // Draw the top and bottom lines
+    i = 0;
+    while (i < TXT_WIN_W / 8) {
+        drw_tile(gl_sset8x8, gl_tex, TL_WIN_TOP, TXT_WIN_X + i*8, TXT_WIN_Y,
+                0/*flipped*/, DRW_LAYER_TEXT_BG);
+        drw_tile(gl_sset8x8, gl_tex, TL_WIN_BOT, TXT_WIN_X + i*8,
+                TXT_WIN_Y + 4*8, 0/*flipped*/, DRW_LAYER_TEXT_BG);
+        i++;
+    }
+    // Draw the lateral lines
+    i = 0;
+    while (i < 5) {
+        drw_tile(gl_sset8x8, gl_tex, TL_WIN_LEFT, TXT_WIN_X, TXT_WIN_Y + i*8,
+                0/*flipped*/, DRW_LAYER_TEXT_BG);
+        drw_tile(gl_sset8x8, gl_tex, TL_WIN_RIGHT, TXT_WIN_X + TXT_WIN_W-8,
+                TXT_WIN_Y + i*8, 0/*flipped*/, DRW_LAYER_TEXT_BG);
         i++;
     }
+    // Draw the corners
+    drw_tile(gl_sset8x8, gl_tex, TL_WIN_TOP_LEFT, TXT_WIN_X, TXT_WIN_Y,
+            0/*flipped*/, DRW_LAYER_TEXT_BG);
+    drw_tile(gl_sset8x8, gl_tex, TL_WIN_TOP_RIGHT, TXT_WIN_X + TXT_WIN_W-8,
+            TXT_WIN_Y, 0/*flipped*/, DRW_LAYER_TEXT_BG);
+    drw_tile(gl_sset8x8, gl_tex, TL_WIN_BOT_LEFT, TXT_WIN_X, TXT_WIN_Y + 4*8,
+            0/*flipped*/, DRW_LAYER_TEXT_BG);
+    drw_tile(gl_sset8x8, gl_tex, TL_WIN_BOT_RIGHT, TXT_WIN_X + TXT_WIN_W-8,
+            TXT_WIN_Y + 4*8, 0/*flipped*/, DRW_LAYER_TEXT_BG);
 }
 
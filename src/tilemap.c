@@ -0,0 +1,589 @@
+/**
+ * @file src/tilemap.c
+ *
+ * Static tilemap, pre-rendered into chunks
+ *
+ * Each chunk is as big as the screen, so a view never overlaps more than 2x2
+ * chunks (i.e., the map is drawn with at most 4 blits)
+ */
+#include <GFraMe/GFraMe_error.h>
+#include <GFraMe/GFraMe_spriteset.h>
+#include <GFraMe/GFraMe_texture.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "camera.h"
+#include "draw.h"
+#include "global.h"
+#include "tilemap.h"
+
+/** Chunk's dimensions, in pixels */
+#define TM_CHUNK_PW (TM_CHUNK_TW * 8)
+#define TM_CHUNK_PH (TM_CHUNK_TH * 8)
+
+/** A run of non-empty tiles on a row, in [ini, end) */
+struct stTilemapSpan {
+    /** First tile on the run */
+    int ini;
+    /** One past the last tile on the run */
+    int end;
+};
+typedef struct stTilemapSpan tmSpan;
+
+/** A single layer of tiles */
+struct stTilemapLayer {
+    /** The layer's data (not owned) */
+    unsigned char *pData;
+    /** Every row's runs of non-empty tiles, sorted from left to right */
+    tmSpan *pSpans;
+    /** How many spans there are allocated */
+    int spansLen;
+    /** Index of each row's first span; Row 'y' ends at pRowSpan[y+1] */
+    int *pRowSpan;
+    /** How many rows there are allocated (plus the last row's end) */
+    int rowSpanLen;
+    /** Whether any tile changed since the spans were built */
+    int spansDirty;
+};
+typedef struct stTilemapLayer tmLayer;
+
+/** The possible states of a chunk */
+enum { TM_CHUNK_DIRTY, TM_CHUNK_CACHED, TM_CHUNK_FAILED };
+
+/** 'Export' the tilemap structure */
+struct stTilemap {
+    /** Layers composited into the chunks, from the back to the front */
+    tmLayer *pLayers;
+    /** How many layers there are in use */
+    int layersUsed;
+    /** How many layers there are allocated */
+    int layersLen;
+    /** Map width, in tiles */
+    int width;
+    /** Map height, in tiles */
+    int height;
+    /** How fast it scrolls relative to the camera, in percents */
+    int parallax;
+    /** Layer where the chunks are queued */
+    drwLayer drawLayer;
+    /** Order within the draw layer */
+    int drawOrder;
+    /** How many chunks there are horizontally */
+    int chunksW;
+    /** How many chunks there are vertically */
+    int chunksH;
+    /** How many chunks were allocated */
+    int chunksLen;
+    /** Every chunk's texture */
+    GFraMe_texture *pChunkTex;
+    /** Spriteset used to render the whole chunk's texture at once */
+    GFraMe_spriteset *pChunkSset;
+    /** Every chunk's state */
+    int *pChunkState;
+    /** Pixel buffer where a chunk is composed before being uploaded */
+    unsigned char *pPixels;
+};
+
+static void tm_clearChunks(tilemap *pTm);
+static int tm_buildSpans(tilemap *pTm, tmLayer *pLayer);
+static void tm_clipRow(int *pIni, int *pEnd, tmLayer *pLayer, int y,
+        int iniX, int endX);
+static void tm_buildChunk(tilemap *pTm, int cx, int cy);
+static void tm_drawChunkTiles(tilemap *pTm, int cx, int cy, int camX,
+        int camY, int iniTX, int iniTY, int endTX, int endTY);
+
+/**
+ * Alloc a new tilemap
+ */
+int tm_getNew(tilemap **ppTm) {
+    int rv;
+    
+    // Check params
+    ASSERT(ppTm, 1);
+    ASSERT(!(*ppTm), 1);
+    
+    // Alloc the tilemap
+    *ppTm = (tilemap*)malloc(sizeof(tilemap));
+    ASSERT(*ppTm, 1);
+    
+    // Clean every variable
+    memset(*ppTm, 0, sizeof(tilemap));
+    
+    // Alloc the buffer used to compose the chunks
+    (*ppTm)->pPixels = (unsigned char*)malloc(TM_CHUNK_PW * TM_CHUNK_PH *
+            TEXBPP);
+    ASSERT((*ppTm)->pPixels, 1);
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Free a tilemap's memory
+ */
+void tm_free(tilemap **ppTm) {
+    int i;
+    
+    // Check params
+    ASSERT_NR(ppTm);
+    ASSERT_NR(*ppTm);
+    
+    tm_clearChunks(*ppTm);
+    if ((*ppTm)->pChunkTex)
+        free((*ppTm)->pChunkTex);
+    if ((*ppTm)->pChunkSset)
+        free((*ppTm)->pChunkSset);
+    if ((*ppTm)->pChunkState)
+        free((*ppTm)->pChunkState);
+    if ((*ppTm)->pPixels)
+        free((*ppTm)->pPixels);
+    
+    i = 0;
+    while (i < (*ppTm)->layersLen) {
+        if ((*ppTm)->pLayers[i].pSpans)
+            free((*ppTm)->pLayers[i].pSpans);
+        if ((*ppTm)->pLayers[i].pRowSpan)
+            free((*ppTm)->pLayers[i].pRowSpan);
+        i++;
+    }
+    if ((*ppTm)->pLayers)
+        free((*ppTm)->pLayers);
+    
+    // Free the tilemap
+    free(*ppTm);
+    *ppTm = 0;
+    
+__ret:
+    return;
+}
+
+/**
+ * Initialize the tilemap and render every one of its chunks
+ *
+ * Every layer is composited (in order) into the same chunks, so only layers
+ * that scroll together should be grouped into a single tilemap
+ *
+ * The data isn't copied, so it must be kept valid by the caller
+ */
+int tm_init(tilemap *pTm, unsigned char **ppLayers, int layersLen, int width,
+        int height, int parallax, drwLayer drawLayer, int drawOrder) {
+    int chunksW, chunksH, cx, cy, i, len, rv;
+    
+    // Check the arguments
+    ASSERT(pTm, 1);
+    ASSERT(ppLayers, 1);
+    ASSERT(layersLen > 0, 1);
+    ASSERT(width > 0, 1);
+    ASSERT(height > 0, 1);
+    
+    // Release the previous map's chunks; The dimensions are only set once
+    // the buffers fit them, so a failure never leaves them indexed past their
+    // end
+    tm_clearChunks(pTm);
+    pTm->chunksW = 0;
+    pTm->chunksH = 0;
+    
+    pTm->width = width;
+    pTm->height = height;
+    pTm->parallax = parallax;
+    pTm->drawLayer = drawLayer;
+    pTm->drawOrder = drawOrder;
+    chunksW = (width + TM_CHUNK_TW - 1) / TM_CHUNK_TW;
+    chunksH = (height + TM_CHUNK_TH - 1) / TM_CHUNK_TH;
+    
+    // Expand the layers, if needed
+    if (layersLen > pTm->layersLen) {
+        pTm->pLayers = (tmLayer*)realloc(pTm->pLayers,
+                sizeof(tmLayer) * layersLen);
+        ASSERT(pTm->pLayers, 1);
+        memset(pTm->pLayers + pTm->layersLen, 0x0,
+                sizeof(tmLayer) * (layersLen - pTm->layersLen));
+        pTm->layersLen = layersLen;
+    }
+    pTm->layersUsed = layersLen;
+    
+    // Index every layer's non-empty tiles
+    i = 0;
+    while (i < layersLen) {
+        pTm->pLayers[i].pData = ppLayers[i];
+        rv = tm_buildSpans(pTm, &pTm->pLayers[i]);
+        ASSERT_NR(rv == 0);
+        i++;
+    }
+    
+    // Expand the buffers, if needed
+    len = chunksW * chunksH;
+    if (len > pTm->chunksLen) {
+        // Nothing is valid until every buffer is expanded
+        pTm->chunksLen = 0;
+        pTm->pChunkTex = (GFraMe_texture*)realloc(pTm->pChunkTex,
+                sizeof(GFraMe_texture) * len);
+        ASSERT(pTm->pChunkTex, 1);
+        pTm->pChunkSset = (GFraMe_spriteset*)realloc(pTm->pChunkSset,
+                sizeof(GFraMe_spriteset) * len);
+        ASSERT(pTm->pChunkSset, 1);
+        pTm->pChunkState = (int*)realloc(pTm->pChunkState, sizeof(int) * len);
+        ASSERT(pTm->pChunkState, 1);
+        pTm->chunksLen = len;
+    }
+    pTm->chunksW = chunksW;
+    pTm->chunksH = chunksH;
+    
+    i = 0;
+    while (i < len) {
+        GFraMe_texture_init(&pTm->pChunkTex[i]);
+        pTm->pChunkState[i] = TM_CHUNK_DIRTY;
+        i++;
+    }
+    
+    // Render every chunk
+    cy = 0;
+    while (cy < pTm->chunksH) {
+        cx = 0;
+        while (cx < pTm->chunksW) {
+            tm_buildChunk(pTm, cx, cy);
+            cx++;
+        }
+        cy++;
+    }
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Modify a tile; Its chunk will be rebuilt on the next draw
+ */
+void tm_setTile(tilemap *pTm, int layer, int x, int y, unsigned char tile) {
+    tmLayer *pLayer;
+    int i;
+    
+    // Check the arguments
+    ASSERT_NR(pTm);
+    ASSERT_NR(layer >= 0 && layer < pTm->layersUsed);
+    ASSERT_NR(x >= 0 && x < pTm->width);
+    ASSERT_NR(y >= 0 && y < pTm->height);
+    
+    pLayer = &pTm->pLayers[layer];
+    ASSERT_NR(pLayer->pData[x + y * pTm->width] != tile);
+    
+    pLayer->pData[x + y * pTm->width] = tile;
+    pLayer->spansDirty = 1;
+    
+    i = x / TM_CHUNK_TW + y / TM_CHUNK_TH * pTm->chunksW;
+    if (pTm->pChunkState[i] == TM_CHUNK_CACHED)
+        GFraMe_texture_clear(&pTm->pChunkTex[i]);
+    pTm->pChunkState[i] = TM_CHUNK_DIRTY;
+__ret:
+    return;
+}
+
+/**
+ * Draw every chunk that overlaps the camera
+ */
+void tm_draw(tilemap *pTm, camera *pCam) {
+    const camView *pView;
+    int camX, camY, cx, cy, i, iniCX, endCX, endCY, iniTX, iniTY, endTX, endTY;
+    
+    // TODO do something if the map is smaller than the screen
+    
+    pView = cam_getView(pCam);
+    
+    // Scroll the layer relative to the camera
+    camX = pView->drawX * pTm->parallax / 100;
+    camY = pView->drawY * pTm->parallax / 100;
+    
+    // Get the visible tiles; Only layers that scroll with the camera may use
+    // the view's range as is
+    if (pTm->parallax == 100) {
+        iniTX = pView->tileIniX;
+        iniTY = pView->tileIniY;
+        endTX = pView->tileEndX;
+        endTY = pView->tileEndY;
+    }
+    else {
+        iniTX = camX / 8;
+        iniTY = camY / 8;
+        endTX = (camX + pView->w + 7) / 8;
+        endTY = (camY + pView->h + 7) / 8;
+        if (iniTX < 0)
+            iniTX = 0;
+        if (iniTY < 0)
+            iniTY = 0;
+    }
+    if (endTX > pTm->width)
+        endTX = pTm->width;
+    if (endTY > pTm->height)
+        endTY = pTm->height;
+    if (iniTX >= endTX || iniTY >= endTY)
+        return;
+    
+    // Re-index the tiles, if any was modified
+    i = 0;
+    while (i < pTm->layersUsed) {
+        if (pTm->pLayers[i].spansDirty &&
+                tm_buildSpans(pTm, &pTm->pLayers[i]) != 0)
+            return;
+        i++;
+    }
+    
+    // Get the range of chunks with any visible tile
+    iniCX = iniTX / TM_CHUNK_TW;
+    cy = iniTY / TM_CHUNK_TH;
+    endCX = (endTX - 1) / TM_CHUNK_TW;
+    endCY = (endTY - 1) / TM_CHUNK_TH;
+    if (endCX >= pTm->chunksW)
+        endCX = pTm->chunksW - 1;
+    if (endCY >= pTm->chunksH)
+        endCY = pTm->chunksH - 1;
+    
+    while (cy <= endCY) {
+        cx = iniCX;
+        while (cx <= endCX) {
+            i = cx + cy * pTm->chunksW;
+            // Rebuild the chunk, if any of its tiles changed
+            if (pTm->pChunkState[i] == TM_CHUNK_DIRTY)
+                tm_buildChunk(pTm, cx, cy);
+            
+            if (pTm->pChunkState[i] == TM_CHUNK_CACHED)
+                drw_orderedTile(&pTm->pChunkSset[i], &pTm->pChunkTex[i], 0,
+                        cx * TM_CHUNK_PW - camX, cy * TM_CHUNK_PH - camY,
+                        0 /* flipped */, pTm->drawLayer, pTm->drawOrder);
+            else
+                tm_drawChunkTiles(pTm, cx, cy, camX, camY, iniTX, iniTY,
+                        endTX, endTY);
+            cx++;
+        }
+        cy++;
+    }
+}
+
+/**
+ * Release every chunk's texture
+ */
+static void tm_clearChunks(tilemap *pTm) {
+    int i;
+    
+    i = 0;
+    while (i < pTm->chunksW * pTm->chunksH) {
+        if (pTm->pChunkState[i] == TM_CHUNK_CACHED)
+            GFraMe_texture_clear(&pTm->pChunkTex[i]);
+        pTm->pChunkState[i] = TM_CHUNK_DIRTY;
+        i++;
+    }
+}
+
+/**
+ * Compose a chunk from the atlas and upload it to its texture
+ */
+static void tm_buildChunk(tilemap *pTm, int cx, int cy) {
+    GFraMe_ret rv;
+    int i, iniX, iniY, endX, endY, l, x, y;
+    
+    i = cx + cy * pTm->chunksW;
+    
+    // Get the chunk's tiles (the last ones may be partially filled)
+    iniX = cx * TM_CHUNK_TW;
+    iniY = cy * TM_CHUNK_TH;
+    endX = iniX + TM_CHUNK_TW;
+    endY = iniY + TM_CHUNK_TH;
+    if (endX > pTm->width)
+        endX = pTm->width;
+    if (endY > pTm->height)
+        endY = pTm->height;
+    
+    // Render every layer's non-empty tiles into the buffer, from the back to
+    // the front
+    memset(pTm->pPixels, 0x0, TM_CHUNK_PW * TM_CHUNK_PH * TEXBPP);
+    l = 0;
+    while (l < pTm->layersUsed) {
+        tmLayer *pLayer;
+        
+        pLayer = &pTm->pLayers[l];
+        y = iniY;
+        while (y < endY) {
+            int j, endSpan;
+            
+            tm_clipRow(&j, &endSpan, pLayer, y, iniX, endX);
+            while (j < endSpan) {
+                unsigned char *pTile;
+                int end;
+                
+                // Clip the span to the chunk
+                x = pLayer->pSpans[j].ini;
+                end = pLayer->pSpans[j].end;
+                if (x < iniX)
+                    x = iniX;
+                if (end > endX)
+                    end = endX;
+                
+                pTile = pLayer->pData + y * pTm->width;
+                while (x < end) {
+                    gl_copyTile(pTm->pPixels, TM_CHUNK_PW, pTile[x],
+                            (x - iniX) * 8, (y - iniY) * 8);
+                    x++;
+                }
+                j++;
+            }
+            y++;
+        }
+        l++;
+    }
+    
+    // Upload it
+    rv = GFraMe_texture_load(&pTm->pChunkTex[i], TM_CHUNK_PW, TM_CHUNK_PH,
+            pTm->pPixels);
+    if (rv != GFraMe_ret_ok) {
+        // Fallback to rendering its tiles every frame
+        pTm->pChunkState[i] = TM_CHUNK_FAILED;
+        return;
+    }
+    GFraMe_spriteset_init(&pTm->pChunkSset[i], &pTm->pChunkTex[i],
+            TM_CHUNK_PW, TM_CHUNK_PH);
+    pTm->pChunkState[i] = TM_CHUNK_CACHED;
+}
+
+/**
+ * Draw the chunk's tiles inside the camera (used only if its texture couldn't
+ * be created)
+ */
+static void tm_drawChunkTiles(tilemap *pTm, int cx, int cy, int camX,
+        int camY, int iniTX, int iniTY, int endTX, int endTY) {
+    int iniX, iniY, endX, endY, l, y;
+    
+    // Get the intersection between the chunk and the visible tiles
+    iniX = cx * TM_CHUNK_TW;
+    iniY = cy * TM_CHUNK_TH;
+    endX = iniX + TM_CHUNK_TW;
+    endY = iniY + TM_CHUNK_TH;
+    if (iniX < iniTX)
+        iniX = iniTX;
+    if (iniY < iniTY)
+        iniY = iniTY;
+    if (endX > endTX)
+        endX = endTX;
+    if (endY > endTY)
+        endY = endTY;
+    
+    l = 0;
+    while (l < pTm->layersUsed) {
+        tmLayer *pLayer;
+        
+        pLayer = &pTm->pLayers[l];
+        y = iniY;
+        while (y < endY) {
+            unsigned char *pTile;
+            int j, endSpan;
+            
+            pTile = pLayer->pData + y * pTm->width;
+            tm_clipRow(&j, &endSpan, pLayer, y, iniX, endX);
+            while (j < endSpan) {
+                int x, end;
+                
+                x = pLayer->pSpans[j].ini;
+                end = pLayer->pSpans[j].end;
+                if (x < iniX)
+                    x = iniX;
+                if (end > endX)
+                    end = endX;
+                
+                while (x < end) {
+                    drw_orderedTile(gl_sset8x8, gl_tex, pTile[x],
+                            x * 8 - camX, y * 8 - camY, 0 /* flipped */,
+                            pTm->drawLayer, pTm->drawOrder);
+                    x++;
+                }
+                j++;
+            }
+            y++;
+        }
+        l++;
+    }
+}
+
+/**
+ * Index every row's runs of non-empty tiles
+ */
+static int tm_buildSpans(tilemap *pTm, tmLayer *pLayer) {
+    int len, rv, x, y;
+    
+    // Make sure there's room for every row's offset
+    if (pLayer->rowSpanLen < pTm->height + 1) {
+        pLayer->pRowSpan = (int*)realloc(pLayer->pRowSpan,
+                sizeof(int) * (pTm->height + 1));
+        ASSERT(pLayer->pRowSpan, 1);
+        pLayer->rowSpanLen = pTm->height + 1;
+    }
+    
+    len = 0;
+    y = 0;
+    while (y < pTm->height) {
+        unsigned char *pTile;
+        
+        pTile = pLayer->pData + y * pTm->width;
+        pLayer->pRowSpan[y] = len;
+        
+        x = 0;
+        while (x < pTm->width) {
+            int ini;
+            
+            // Skip empty tiles
+            while (x < pTm->width && pTile[x] == TM_EMPTY_TILE)
+                x++;
+            if (x == pTm->width)
+                break;
+            
+            // Find the run's end
+            ini = x;
+            while (x < pTm->width && pTile[x] != TM_EMPTY_TILE)
+                x++;
+            
+            // Store the span, expanding the buffer as necessary
+            if (len >= pLayer->spansLen) {
+                int newLen;
+                
+                newLen = pLayer->spansLen * 2;
+                if (newLen < pTm->height)
+                    newLen = pTm->height;
+                pLayer->pSpans = (tmSpan*)realloc(pLayer->pSpans,
+                        sizeof(tmSpan) * newLen);
+                ASSERT(pLayer->pSpans, 1);
+                pLayer->spansLen = newLen;
+            }
+            pLayer->pSpans[len].ini = ini;
+            pLayer->pSpans[len].end = x;
+            len++;
+        }
+        y++;
+    }
+    pLayer->pRowSpan[pTm->height] = len;
+    pLayer->spansDirty = 0;
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Get the range of a row's spans that overlap the columns [iniX, endX)
+ */
+static void tm_clipRow(int *pIni, int *pEnd, tmLayer *pLayer, int y,
+        int iniX, int endX) {
+    int i, end;
+    
+    i = pLayer->pRowSpan[y];
+    end = pLayer->pRowSpan[y + 1];
+    
+    // Skip every span to the left
+    while (i < end && pLayer->pSpans[i].end <= iniX)
+        i++;
+    *pIni = i;
+    // Stop at the first span to the right
+    while (i < end && pLayer->pSpans[i].ini < endX)
+        i++;
+    *pEnd = i;
+}
+
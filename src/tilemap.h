@@ -0,0 +1,53 @@
+/**
+ * @file src/tilemap.h
+ *
+ * Static tilemap, pre-rendered into chunks
+ */
+#ifndef __TILEMAP_H__
+#define __TILEMAP_H__
+
+#include "camera.h"
+#include "draw.h"
+
+/** 'Export' the tilemap structure */
+typedef struct stTilemap tilemap;
+
+/**
+ * Alloc a new tilemap
+ */
+int tm_getNew(tilemap **ppTm);
+
+/**
+ * Free a tilemap's memory
+ */
+void tm_free(tilemap **ppTm);
+
+/**
+ * Initialize the tilemap and render every one of its chunks
+ *
+ * Every layer is composited (in order) into the same chunks, so only layers
+ * that scroll together should be grouped into a single tilemap
+ *
+ * The data isn't copied, so it must be kept valid by the caller
+ *
+ * @param parallax How fast it scrolls relative to the camera, in percents
+ * @param drawLayer Layer where the chunks are queued
+ * @param drawOrder Order within the draw layer (so tilemaps sharing a layer
+ *                  keep their order)
+ */
+int tm_init(tilemap *pTm, unsigned char **ppLayers, int layersLen, int width,
+        int height, int parallax, drwLayer drawLayer, int drawOrder);
+
+/**
+ * Modify a tile on one of the layers; Its chunk will be rebuilt on the next
+ * draw
+ */
+void tm_setTile(tilemap *pTm, int layer, int x, int y, unsigned char tile);
+
+/**
+ * Draw every chunk that overlaps the camera
+ */
+void tm_draw(tilemap *pTm, camera *pCam);
+
+#endif /* __TILEMAP_H__ */
+
@@ -0,0 +1,41 @@
+/**
+ * @file src/tiles.h
+ *
+ * Generated by atlas_packer from assets/atlas.def; Don't modify it by hand!
+ */
+#ifndef __TILES_H__
+#define __TILES_H__
+
+/** Packed atlas' dimensions */
+#define ATLAS_W 256
+#define ATLAS_H 64
+
+#define TL_FONT 0
+#define TL_FONT_LEN 64
+#define TL_WIN_TOP_LEFT 81
+#define TL_WIN_TOP 82
+#define TL_WIN_TOP_RIGHT 83
+#define TL_WIN_LEFT 84
+#define TL_WIN_CENTER 85
+#define TL_WIN_RIGHT 86
+#define TL_WIN_BOT_LEFT 87
+#define TL_WIN_BOT 88
+#define TL_WIN_BOT_RIGHT 89
+#define TL_UI_EMPTY 90
+#define TL_UI_STONE 110
+#define TL_UI_STONE_LEN 7
+#define TL_PL_IDLE 39
+#define TL_PL_IDLE_LEN 4
+#define TL_PL_WALK 43
+#define TL_PL_WALK_LEN 5
+#define TL_PL_JUMP 41
+#define TL_PL_LASER 30
+#define TL_PL_DEATH 31
+#define TL_PL_TARGET 91
+#define TL_STONE 117
+#define TL_STONE_LEN 7
+#define TL_BULLET 796
+#define TL_BULLET_LEN 7
+
+#endif /* __TILES_H__ */
+
@@ -5,6 +5,7 @@
  */
 #include <GFraMe/GFraMe_spriteset.h>
 
+#include "draw.h"
 #include "global.h"
 #include "player.h"
 #include "sprite.h"
@@ -30,7 +31,7 @@ void ui_draw(player *pPl) {
     x = 8;
     y = 8;
     tmp = SPR_RED_STONE;
-    curTile = 261;
+    curTile = TL_UI_STONE;
     while (tmp < 0x100) {
         int tile;
         
@@ -48,19 +49,19 @@ void ui_draw(player *pPl) {
                 //if (val > 5)
                     tile = curTile;
                 //else
-                //    tile = 260;
+                //    tile = TL_UI_EMPTY;
                 
                 laserDur = 0;
             }
             else
-                tile = 260;
+                tile = TL_UI_EMPTY;
         }
         else {
-            tile = 260;
+            tile = TL_UI_EMPTY;
         }
         
         // Draw the current tile
-        GFraMe_spriteset_draw(gl_sset8x8, tile, x, y, 0/*flipped*/);
+        drw_tile(gl_sset8x8, gl_tex, tile, x, y, 0/*flipped*/, DRW_LAYER_UI);
         
         // Got to the next stone
         tmp <<= 1;
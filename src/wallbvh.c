@@ -0,0 +1,420 @@
+/**
+ * @file src/wallbvh.c
+ *
+ * Static bounding volume hierarchy over the map's walls; Unlike the uniform
+ * grid, it isn't affected by how much the walls' dimensions vary, and every
+ * query is logarithmic on the number of walls
+ *
+ * It's built top-down, splitting each node at the median of its walls'
+ * centers, along its longest axis; Both children of a node are stored
+ * consecutively
+ */
+#include <GFraMe/GFraMe_object.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "wallbvh.h"
+
+/** Nodes that may be pending on a query; As nodes are split at the median,
+ * the tree's depth is (at most) log2 of the number of walls */
+#define BVH_STACK_LEN 64
+
+/** An axis-aligned box, with inclusive bounds */
+struct stBvhBox {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+};
+typedef struct stBvhBox bvhBox;
+
+/** A wall and its cached bounds */
+struct stBvhItem {
+    /** The wall's bounds */
+    bvhBox box;
+    /** Index of the wall */
+    int wall;
+};
+typedef struct stBvhItem bvhItem;
+
+/** A node on the hierarchy */
+struct stBvhNode {
+    /** Bounds of everything under this node */
+    bvhBox box;
+    /** First item, on a leaf; Otherwise, the first of its two children */
+    int first;
+    /** How many items there are on a leaf (0, on inner nodes) */
+    int count;
+};
+typedef struct stBvhNode bvhNode;
+
+/** A box moving by (dx, dy) (a static box, if both are 0) */
+struct stBvhQuery {
+    int x;
+    int y;
+    int w;
+    int h;
+    int dx;
+    int dy;
+};
+typedef struct stBvhQuery bvhQuery;
+
+/** 'Export' the wall BVH structure */
+struct stWallBvh {
+    /** The map's walls (not owned) */
+    GFraMe_object *pWalls;
+    /** Every wall, sorted so each leaf's are consecutive */
+    bvhItem *pItems;
+    /** How many items there are in use */
+    int itemsUsed;
+    /** How many items there are allocated */
+    int itemsLen;
+    /** The hierarchy; The root is the first node */
+    bvhNode *pNodes;
+    /** How many nodes there are in use */
+    int nodesUsed;
+    /** How many nodes there are allocated */
+    int nodesLen;
+    /** Walls returned by the last query */
+    GFraMe_object **ppHits;
+};
+
+/**
+ * Sort items by their centers, horizontally
+ */
+static int bvh_cmpX(const void *pA, const void *pB) {
+    const bvhBox *pBoxA = &((const bvhItem*)pA)->box;
+    const bvhBox *pBoxB = &((const bvhItem*)pB)->box;
+    
+    return (pBoxA->x0 + pBoxA->x1) - (pBoxB->x0 + pBoxB->x1);
+}
+
+/**
+ * Sort items by their centers, vertically
+ */
+static int bvh_cmpY(const void *pA, const void *pB) {
+    const bvhBox *pBoxA = &((const bvhItem*)pA)->box;
+    const bvhBox *pBoxB = &((const bvhItem*)pB)->box;
+    
+    return (pBoxA->y0 + pBoxA->y1) - (pBoxB->y0 + pBoxB->y1);
+}
+
+/**
+ * Build a node (and everything under it) over a range of items
+ */
+static void bvh_build(wallBvh *pBvh, int node, int first, int count) {
+    bvhNode *pNode;
+    int cx0, cy0, cx1, cy1, i, half;
+    
+    pNode = &pBvh->pNodes[node];
+    pNode->box = pBvh->pItems[first].box;
+    cx0 = cx1 = pBvh->pItems[first].box.x0 + pBvh->pItems[first].box.x1;
+    cy0 = cy1 = pBvh->pItems[first].box.y0 + pBvh->pItems[first].box.y1;
+    
+    // Get the node's bounds and the bounds of its items' centers (doubled)
+    i = first + 1;
+    while (i < first + count) {
+        bvhBox *pBox;
+        int cx, cy;
+        
+        pBox = &pBvh->pItems[i].box;
+        if (pBox->x0 < pNode->box.x0)
+            pNode->box.x0 = pBox->x0;
+        if (pBox->y0 < pNode->box.y0)
+            pNode->box.y0 = pBox->y0;
+        if (pBox->x1 > pNode->box.x1)
+            pNode->box.x1 = pBox->x1;
+        if (pBox->y1 > pNode->box.y1)
+            pNode->box.y1 = pBox->y1;
+        
+        cx = pBox->x0 + pBox->x1;
+        cy = pBox->y0 + pBox->y1;
+        if (cx < cx0)
+            cx0 = cx;
+        else if (cx > cx1)
+            cx1 = cx;
+        if (cy < cy0)
+            cy0 = cy;
+        else if (cy > cy1)
+            cy1 = cy;
+        i++;
+    }
+    
+    // Few (or overlapping) walls are simply kept together
+    if (count <= BVH_LEAF_WALLS || (cx0 == cx1 && cy0 == cy1)) {
+        pNode->first = first;
+        pNode->count = count;
+        return;
+    }
+    
+    // Split it at the median, along the axis where the centers spread most
+    if (cx1 - cx0 >= cy1 - cy0)
+        qsort(pBvh->pItems + first, count, sizeof(bvhItem), bvh_cmpX);
+    else
+        qsort(pBvh->pItems + first, count, sizeof(bvhItem), bvh_cmpY);
+    
+    half = count / 2;
+    pNode->first = pBvh->nodesUsed;
+    pNode->count = 0;
+    pBvh->nodesUsed += 2;
+    
+    bvh_build(pBvh, pNode->first, first, half);
+    bvh_build(pBvh, pNode->first + 1, first + half, count - half);
+}
+
+/**
+ * Check whether a moving box touches a static one at any point of its path
+ */
+static int bvh_touches(bvhBox *pBox, bvhQuery *pQ) {
+    double tIni, tEnd, t0, t1;
+    
+    // The moving box touches pBox while its top-left corner is inside pBox
+    // extended by the moving box's dimensions
+    tIni = 0.0;
+    tEnd = 1.0;
+    
+    if (pQ->dx == 0) {
+        if (pQ->x + pQ->w < pBox->x0 || pQ->x > pBox->x1)
+            return 0;
+    }
+    else {
+        t0 = (double)(pBox->x0 - pQ->w - pQ->x) / pQ->dx;
+        t1 = (double)(pBox->x1 - pQ->x) / pQ->dx;
+        if (t0 > t1) {
+            double tmp;
+            
+            tmp = t0;
+            t0 = t1;
+            t1 = tmp;
+        }
+        if (t0 > tIni)
+            tIni = t0;
+        if (t1 < tEnd)
+            tEnd = t1;
+        if (tIni > tEnd)
+            return 0;
+    }
+    
+    if (pQ->dy == 0) {
+        if (pQ->y + pQ->h < pBox->y0 || pQ->y > pBox->y1)
+            return 0;
+    }
+    else {
+        t0 = (double)(pBox->y0 - pQ->h - pQ->y) / pQ->dy;
+        t1 = (double)(pBox->y1 - pQ->y) / pQ->dy;
+        if (t0 > t1) {
+            double tmp;
+            
+            tmp = t0;
+            t0 = t1;
+            t1 = tmp;
+        }
+        if (t0 > tIni)
+            tIni = t0;
+        if (t1 < tEnd)
+            tEnd = t1;
+        if (tIni > tEnd)
+            return 0;
+    }
+    
+    return 1;
+}
+
+/**
+ * Retrieve every wall touched by a (possibly moving) box
+ */
+static void bvh_query(GFraMe_object ***pppWalls, int *pLen, wallBvh *pBvh,
+        bvhQuery *pQ) {
+    int pStack[BVH_STACK_LEN];
+    int len, stackLen;
+    
+    *pppWalls = pBvh->ppHits;
+    *pLen = 0;
+    if (pBvh->nodesUsed == 0)
+        return;
+    
+    len = 0;
+    pStack[0] = 0;
+    stackLen = 1;
+    while (stackLen > 0) {
+        bvhNode *pNode;
+        
+        stackLen--;
+        pNode = &pBvh->pNodes[pStack[stackLen]];
+        if (!bvh_touches(&pNode->box, pQ))
+            continue;
+        
+        if (pNode->count > 0) {
+            int i;
+            
+            i = pNode->first;
+            while (i < pNode->first + pNode->count) {
+                if (bvh_touches(&pBvh->pItems[i].box, pQ)) {
+                    pBvh->ppHits[len] =
+                            &pBvh->pWalls[pBvh->pItems[i].wall];
+                    len++;
+                }
+                i++;
+            }
+        }
+        else if (stackLen + 2 <= BVH_STACK_LEN) {
+            pStack[stackLen] = pNode->first + 1;
+            pStack[stackLen + 1] = pNode->first;
+            stackLen += 2;
+        }
+    }
+    
+    *pLen = len;
+}
+
+/**
+ * Alloc a new wall BVH
+ */
+int bvh_getNew(wallBvh **ppBvh) {
+    int rv;
+    
+    // Check params
+    ASSERT(ppBvh, 1);
+    ASSERT(!(*ppBvh), 1);
+    
+    // Alloc the hierarchy
+    *ppBvh = (wallBvh*)malloc(sizeof(wallBvh));
+    ASSERT(*ppBvh, 1);
+    
+    // Clean every variable
+    memset(*ppBvh, 0, sizeof(wallBvh));
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Free a wall BVH's memory
+ */
+void bvh_free(wallBvh **ppBvh) {
+    // Check params
+    ASSERT_NR(ppBvh);
+    ASSERT_NR(*ppBvh);
+    
+    if ((*ppBvh)->pItems)
+        free((*ppBvh)->pItems);
+    if ((*ppBvh)->pNodes)
+        free((*ppBvh)->pNodes);
+    if ((*ppBvh)->ppHits)
+        free((*ppBvh)->ppHits);
+    
+    // Free the hierarchy
+    free(*ppBvh);
+    *ppBvh = 0;
+    
+__ret:
+    return;
+}
+
+/**
+ * Build the hierarchy over every wall
+ */
+int bvh_init(wallBvh *pBvh, GFraMe_object *pWalls, int wallsLen) {
+    int i, rv;
+    
+    // Check the arguments
+    ASSERT(pBvh, 1);
+    ASSERT(pWalls || wallsLen == 0, 1);
+    
+    pBvh->pWalls = pWalls;
+    pBvh->itemsUsed = 0;
+    pBvh->nodesUsed = 0;
+    if (wallsLen == 0) {
+        rv = 0;
+        goto __ret;
+    }
+    
+    // Expand the buffers, if needed; A binary tree with a leaf per wall has
+    // (at most) 2n - 1 nodes
+    if (wallsLen > pBvh->itemsLen) {
+        pBvh->pItems = (bvhItem*)realloc(pBvh->pItems,
+                sizeof(bvhItem) * wallsLen);
+        ASSERT(pBvh->pItems, 1);
+        pBvh->ppHits = (GFraMe_object**)realloc(pBvh->ppHits,
+                sizeof(GFraMe_object*) * wallsLen);
+        ASSERT(pBvh->ppHits, 1);
+        pBvh->itemsLen = wallsLen;
+    }
+    if (wallsLen * 2 - 1 > pBvh->nodesLen) {
+        pBvh->pNodes = (bvhNode*)realloc(pBvh->pNodes,
+                sizeof(bvhNode) * (wallsLen * 2 - 1));
+        ASSERT(pBvh->pNodes, 1);
+        pBvh->nodesLen = wallsLen * 2 - 1;
+    }
+    
+    // Cache every wall's bounds
+    i = 0;
+    while (i < wallsLen) {
+        GFraMe_object *pWall;
+        bvhItem *pItem;
+        
+        pWall = &pWalls[i];
+        pItem = &pBvh->pItems[i];
+        pItem->box.x0 = pWall->x + pWall->hitbox.cx - pWall->hitbox.hw;
+        pItem->box.y0 = pWall->y + pWall->hitbox.cy - pWall->hitbox.hh;
+        pItem->box.x1 = pWall->x + pWall->hitbox.cx + pWall->hitbox.hw;
+        pItem->box.y1 = pWall->y + pWall->hitbox.cy + pWall->hitbox.hh;
+        pItem->wall = i;
+        i++;
+    }
+    pBvh->itemsUsed = wallsLen;
+    
+    pBvh->nodesUsed = 1;
+    bvh_build(pBvh, 0, 0, wallsLen);
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Retrieve every wall that overlaps (or touches) a box; The list is only valid
+ * until the next query
+ */
+void bvh_queryBox(GFraMe_object ***pppWalls, int *pLen, wallBvh *pBvh, int x,
+        int y, int w, int h) {
+    bvhQuery q;
+    
+    q.x = x;
+    q.y = y;
+    q.w = w;
+    q.h = h;
+    q.dx = 0;
+    q.dy = 0;
+    bvh_query(pppWalls, pLen, pBvh, &q);
+}
+
+/**
+ * Retrieve every wall that contains a point; The list is only valid until the
+ * next query
+ */
+void bvh_queryPoint(GFraMe_object ***pppWalls, int *pLen, wallBvh *pBvh,
+        int x, int y) {
+    bvh_queryBox(pppWalls, pLen, pBvh, x, y, 0, 0);
+}
+
+/**
+ * Retrieve every wall that a box touches while moving by (dx, dy); The list is
+ * only valid until the next query
+ */
+void bvh_querySwept(GFraMe_object ***pppWalls, int *pLen, wallBvh *pBvh,
+        int x, int y, int w, int h, int dx, int dy) {
+    bvhQuery q;
+    
+    q.x = x;
+    q.y = y;
+    q.w = w;
+    q.h = h;
+    q.dx = dx;
+    q.dy = dy;
+    bvh_query(pppWalls, pLen, pBvh, &q);
+}
+
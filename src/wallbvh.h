@@ -0,0 +1,67 @@
+/**
+ * @file src/wallbvh.h
+ *
+ * Static bounding volume hierarchy over the map's walls; Unlike the uniform
+ * grid, it isn't affected by how much the walls' dimensions vary, and every
+ * query is logarithmic on the number of walls
+ */
+#ifndef __WALLBVH_H__
+#define __WALLBVH_H__
+
+#include <GFraMe/GFraMe_object.h>
+
+/** 'Export' the wall BVH structure */
+typedef struct stWallBvh wallBvh;
+
+/**
+ * Alloc a new wall BVH
+ */
+int bvh_getNew(wallBvh **ppBvh);
+
+/**
+ * Free a wall BVH's memory
+ */
+void bvh_free(wallBvh **ppBvh);
+
+/**
+ * Build the hierarchy over every wall
+ *
+ * The walls aren't copied (nor may they be moved), so they must be kept valid
+ * by the caller
+ */
+int bvh_init(wallBvh *pBvh, GFraMe_object *pWalls, int wallsLen);
+
+/**
+ * Retrieve every wall that overlaps (or touches) a box; The list is only valid
+ * until the next query
+ *
+ * @param x The box's left side, in world space
+ * @param y The box's top side, in world space
+ */
+void bvh_queryBox(GFraMe_object ***pppWalls, int *pLen, wallBvh *pBvh, int x,
+        int y, int w, int h);
+
+/**
+ * Retrieve every wall that contains a point; The list is only valid until the
+ * next query
+ *
+ * Not used by the game yet (collisions only need bvh_queryBox)
+ */
+void bvh_queryPoint(GFraMe_object ***pppWalls, int *pLen, wallBvh *pBvh,
+        int x, int y);
+
+/**
+ * Retrieve every wall that a box touches while moving by (dx, dy); The list is
+ * only valid until the next query
+ *
+ * Not used by the game yet; GFraMe only separates objects that overlap at
+ * their current position, so it can't resolve what a sweep finds
+ *
+ * @param x The box's left side, before moving
+ * @param y The box's top side, before moving
+ */
+void bvh_querySwept(GFraMe_object ***pppWalls, int *pLen, wallBvh *pBvh,
+        int x, int y, int w, int h, int dx, int dy);
+
+#endif /* __WALLBVH_H__ */
+
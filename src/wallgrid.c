@@ -0,0 +1,291 @@
+/**
+ * @file src/wallgrid.c
+ *
+ * Static uniform grid over the map's walls, so a collision only tests the walls
+ * on the cells that its bounding box touches
+ *
+ * Cells are stored compressed: every cell's walls are laid out consecutively
+ * on a single list, and each cell only keeps where its walls start
+ */
+#include <GFraMe/GFraMe_object.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "wallgrid.h"
+
+/** 'Export' the wall grid structure */
+struct stWallGrid {
+    /** The map's walls (not owned) */
+    GFraMe_object *pWalls;
+    /** How many walls there are in use */
+    int wallsUsed;
+    /** How many cells there are horizontally */
+    int cellsW;
+    /** How many cells there are vertically */
+    int cellsH;
+    /** Index of each cell's first wall; Cell 'i' ends at pCellIni[i+1] */
+    int *pCellIni;
+    /** How many cells there are allocated (plus the last cell's end) */
+    int cellIniLen;
+    /** Index of the walls on every cell, sorted by cell */
+    int *pCellWalls;
+    /** How many indices there are allocated */
+    int cellWallsLen;
+    /** Last query that returned each wall */
+    unsigned int *pWallQuery;
+    /** Walls returned by the last query */
+    GFraMe_object **ppHits;
+    /** How many walls there are allocated (on both pWallQuery and ppHits) */
+    int wallsLen;
+    /** Current query, so walls on many cells are only returned once */
+    unsigned int query;
+};
+
+/**
+ * Get the (clamped) cells that a box overlaps, in [ini, end)
+ */
+static void wg_getCells(int *pIniX, int *pIniY, int *pEndX, int *pEndY,
+        wallGrid *pWg, int x, int y, int w, int h) {
+    *pIniX = x / WG_CELL_SIZE;
+    *pIniY = y / WG_CELL_SIZE;
+    *pEndX = (x + w) / WG_CELL_SIZE + 1;
+    *pEndY = (y + h) / WG_CELL_SIZE + 1;
+    
+    if (*pIniX < 0)
+        *pIniX = 0;
+    else if (*pIniX >= pWg->cellsW)
+        *pIniX = pWg->cellsW - 1;
+    if (*pIniY < 0)
+        *pIniY = 0;
+    else if (*pIniY >= pWg->cellsH)
+        *pIniY = pWg->cellsH - 1;
+    if (*pEndX > pWg->cellsW)
+        *pEndX = pWg->cellsW;
+    else if (*pEndX <= *pIniX)
+        *pEndX = *pIniX + 1;
+    if (*pEndY > pWg->cellsH)
+        *pEndY = pWg->cellsH;
+    else if (*pEndY <= *pIniY)
+        *pEndY = *pIniY + 1;
+}
+
+/**
+ * Get the cells that a wall overlaps
+ */
+static void wg_getWallCells(int *pIniX, int *pIniY, int *pEndX, int *pEndY,
+        wallGrid *pWg, GFraMe_object *pWall) {
+    GFraMe_hitbox *pHb;
+    
+    pHb = &pWall->hitbox;
+    wg_getCells(pIniX, pIniY, pEndX, pEndY, pWg,
+            pWall->x + pHb->cx - pHb->hw, pWall->y + pHb->cy - pHb->hh,
+            pHb->hw * 2, pHb->hh * 2);
+}
+
+/**
+ * Alloc a new wall grid
+ */
+int wg_getNew(wallGrid **ppWg) {
+    int rv;
+    
+    // Check params
+    ASSERT(ppWg, 1);
+    ASSERT(!(*ppWg), 1);
+    
+    // Alloc the grid
+    *ppWg = (wallGrid*)malloc(sizeof(wallGrid));
+    ASSERT(*ppWg, 1);
+    
+    // Clean every variable
+    memset(*ppWg, 0, sizeof(wallGrid));
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Free a wall grid's memory
+ */
+void wg_free(wallGrid **ppWg) {
+    // Check params
+    ASSERT_NR(ppWg);
+    ASSERT_NR(*ppWg);
+    
+    if ((*ppWg)->pCellIni)
+        free((*ppWg)->pCellIni);
+    if ((*ppWg)->pCellWalls)
+        free((*ppWg)->pCellWalls);
+    if ((*ppWg)->pWallQuery)
+        free((*ppWg)->pWallQuery);
+    if ((*ppWg)->ppHits)
+        free((*ppWg)->ppHits);
+    
+    // Free the grid
+    free(*ppWg);
+    *ppWg = 0;
+    
+__ret:
+    return;
+}
+
+/**
+ * Bin every wall into the cells it overlaps; Walls outside the map are binned
+ * into the border cells
+ */
+int wg_init(wallGrid *pWg, GFraMe_object *pWalls, int wallsLen, int width,
+        int height) {
+    int cells, i, len, rv;
+    
+    // Check the arguments
+    ASSERT(pWg, 1);
+    ASSERT(pWalls || wallsLen == 0, 1);
+    ASSERT(width > 0, 1);
+    ASSERT(height > 0, 1);
+    
+    pWg->pWalls = pWalls;
+    pWg->wallsUsed = wallsLen;
+    pWg->cellsW = (width + WG_CELL_SIZE - 1) / WG_CELL_SIZE;
+    pWg->cellsH = (height + WG_CELL_SIZE - 1) / WG_CELL_SIZE;
+    cells = pWg->cellsW * pWg->cellsH;
+    
+    // Expand the buffers, if needed
+    if (cells + 1 > pWg->cellIniLen) {
+        pWg->pCellIni = (int*)realloc(pWg->pCellIni, sizeof(int) *
+                (cells + 1));
+        ASSERT(pWg->pCellIni, 1);
+        pWg->cellIniLen = cells + 1;
+    }
+    if (wallsLen > pWg->wallsLen) {
+        pWg->pWallQuery = (unsigned int*)realloc(pWg->pWallQuery,
+                sizeof(unsigned int) * wallsLen);
+        ASSERT(pWg->pWallQuery, 1);
+        pWg->ppHits = (GFraMe_object**)realloc(pWg->ppHits,
+                sizeof(GFraMe_object*) * wallsLen);
+        ASSERT(pWg->ppHits, 1);
+        pWg->wallsLen = wallsLen;
+    }
+    if (wallsLen > 0)
+        memset(pWg->pWallQuery, 0x0, sizeof(unsigned int) * wallsLen);
+    pWg->query = 0;
+    
+    // Count how many walls each cell has (shifted by one, so it may be turned
+    // into each cell's end)
+    memset(pWg->pCellIni, 0x0, sizeof(int) * (cells + 1));
+    i = 0;
+    while (i < wallsLen) {
+        int iniX, iniY, endX, endY, x, y;
+        
+        wg_getWallCells(&iniX, &iniY, &endX, &endY, pWg, &pWalls[i]);
+        y = iniY;
+        while (y < endY) {
+            x = iniX;
+            while (x < endX) {
+                pWg->pCellIni[y * pWg->cellsW + x + 1]++;
+                x++;
+            }
+            y++;
+        }
+        i++;
+    }
+    
+    // Accumulate it into each cell's first wall
+    i = 0;
+    while (i < cells) {
+        pWg->pCellIni[i + 1] += pWg->pCellIni[i];
+        i++;
+    }
+    
+    len = pWg->pCellIni[cells];
+    if (len > pWg->cellWallsLen) {
+        pWg->pCellWalls = (int*)realloc(pWg->pCellWalls, sizeof(int) * len);
+        ASSERT(pWg->pCellWalls, 1);
+        pWg->cellWallsLen = len;
+    }
+    
+    // Place every wall, moving each cell's start up to its end as it's filled
+    i = 0;
+    while (i < wallsLen) {
+        int iniX, iniY, endX, endY, x, y;
+        
+        wg_getWallCells(&iniX, &iniY, &endX, &endY, pWg, &pWalls[i]);
+        y = iniY;
+        while (y < endY) {
+            x = iniX;
+            while (x < endX) {
+                int *pIni;
+                
+                pIni = &pWg->pCellIni[y * pWg->cellsW + x];
+                pWg->pCellWalls[*pIni] = i;
+                (*pIni)++;
+                x++;
+            }
+            y++;
+        }
+        i++;
+    }
+    
+    // Shift it back, so each cell starts where the previous one ends
+    i = cells;
+    while (i > 0) {
+        pWg->pCellIni[i] = pWg->pCellIni[i - 1];
+        i--;
+    }
+    pWg->pCellIni[0] = 0;
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
+/**
+ * Retrieve every wall on the cells that a box touches (each one only once);
+ * The list is only valid until the next query
+ */
+void wg_query(GFraMe_object ***pppWalls, int *pLen, wallGrid *pWg, int x,
+        int y, int w, int h) {
+    int iniX, iniY, endX, endY, len, cx, cy;
+    
+    *pppWalls = pWg->ppHits;
+    *pLen = 0;
+    if (pWg->wallsUsed == 0)
+        return;
+    
+    // Restart the counter before it wraps, so no stale mark may match
+    pWg->query++;
+    if (pWg->query == 0) {
+        memset(pWg->pWallQuery, 0x0, sizeof(unsigned int) * pWg->wallsUsed);
+        pWg->query = 1;
+    }
+    
+    wg_getCells(&iniX, &iniY, &endX, &endY, pWg, x, y, w, h);
+    len = 0;
+    cy = iniY;
+    while (cy < endY) {
+        cx = iniX;
+        while (cx < endX) {
+            int cell, i;
+            
+            cell = cy * pWg->cellsW + cx;
+            i = pWg->pCellIni[cell];
+            while (i < pWg->pCellIni[cell + 1]) {
+                int wall;
+                
+                wall = pWg->pCellWalls[i];
+                if (pWg->pWallQuery[wall] != pWg->query) {
+                    pWg->pWallQuery[wall] = pWg->query;
+                    pWg->ppHits[len] = &pWg->pWalls[wall];
+                    len++;
+                }
+                i++;
+            }
+            cx++;
+        }
+        cy++;
+    }
+    
+    *pLen = len;
+}
+
@@ -0,0 +1,49 @@
+/**
+ * @file src/wallgrid.h
+ *
+ * Static uniform grid over the map's walls, so a collision only tests the walls
+ * on the cells that its bounding box touches
+ */
+#ifndef __WALLGRID_H__
+#define __WALLGRID_H__
+
+#include <GFraMe/GFraMe_object.h>
+
+/** 'Export' the wall grid structure */
+typedef struct stWallGrid wallGrid;
+
+/**
+ * Alloc a new wall grid
+ */
+int wg_getNew(wallGrid **ppWg);
+
+/**
+ * Free a wall grid's memory
+ */
+void wg_free(wallGrid **ppWg);
+
+/**
+ * Bin every wall into the cells it overlaps; Walls outside the map are binned
+ * into the border cells
+ *
+ * The walls aren't copied (nor may they be moved), so they must be kept valid
+ * by the caller
+ *
+ * @param width Map width, in pixels
+ * @param height Map height, in pixels
+ */
+int wg_init(wallGrid *pWg, GFraMe_object *pWalls, int wallsLen, int width,
+        int height);
+
+/**
+ * Retrieve every wall on the cells that a box touches (each one only once);
+ * The list is only valid until the next query
+ *
+ * @param x The box's left side, in world space
+ * @param y The box's top side, in world space
+ */
+void wg_query(GFraMe_object ***pppWalls, int *pLen, wallGrid *pWg, int x,
+        int y, int w, int h);
+
+#endif /* __WALLGRID_H__ */
+
@@ -0,0 +1,80 @@
+/**
+ * @file src/wave.c
+ * 
+ * Parser for the header of PCM wave files
+ */
+#include <SDL2/SDL_audio.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "global.h"
+#include "wave.h"
+
+/**
+ * Read a little-endian integer from the file
+ */
+static unsigned int wv_readInt(FILE *pFp, int len) {
+    unsigned char pBuf[4];
+    unsigned int val;
+    
+    memset(pBuf, 0x0, sizeof(pBuf));
+    if (fread(pBuf, len, 1, pFp) != 1)
+        return 0;
+    
+    val = pBuf[0] | (pBuf[1] << 8) | (pBuf[2] << 16) |
+            ((unsigned int)pBuf[3] << 24);
+    return val;
+}
+
+/**
+ * Read a wave's header, leaving the file at the start of its samples; Only
+ * uncompressed 8 or 16 bits PCM is accepted
+ */
+int wv_readHeader(FILE *pFp, SDL_AudioSpec *pSpec, unsigned int *pLen) {
+    unsigned int id, len;
+    int didReadFmt, rv;
+    
+    didReadFmt = 0;
+    memset(pSpec, 0x0, sizeof(SDL_AudioSpec));
+    
+    ASSERT(wv_readInt(pFp, 4) == 0x46464952, 1); // "RIFF"
+    wv_readInt(pFp, 4);
+    ASSERT(wv_readInt(pFp, 4) == 0x45564157, 1); // "WAVE"
+    
+    while (1) {
+        id = wv_readInt(pFp, 4);
+        len = wv_readInt(pFp, 4);
+        ASSERT(!feof(pFp), 1);
+        
+        if (id == 0x20746d66) { // "fmt "
+            int bits;
+            
+            ASSERT(len >= 16, 1);
+            ASSERT(wv_readInt(pFp, 2) == 1, 1);
+            pSpec->channels = wv_readInt(pFp, 2);
+            pSpec->freq = wv_readInt(pFp, 4);
+            wv_readInt(pFp, 4);
+            wv_readInt(pFp, 2);
+            bits = wv_readInt(pFp, 2);
+            ASSERT(bits == 8 || bits == 16, 1);
+            ASSERT(pSpec->channels > 0 && pSpec->freq > 0, 1);
+            pSpec->format = (bits == 8) ? AUDIO_U8 : AUDIO_S16LSB;
+            
+            fseek(pFp, len - 16 + (len & 1), SEEK_CUR);
+            didReadFmt = 1;
+        }
+        else if (id == 0x61746164) { // "data"
+            ASSERT(didReadFmt, 1);
+            *pLen = len;
+            break;
+        }
+        else
+            fseek(pFp, len + (len & 1), SEEK_CUR);
+    }
+    
+    rv = 0;
+__ret:
+    return rv;
+}
+
@@ -0,0 +1,24 @@
+/**
+ * @file src/wave.h
+ * 
+ * Parser for the header of PCM wave files
+ */
+#ifndef __WAVE_H__
+#define __WAVE_H__
+
+#include <SDL2/SDL_audio.h>
+
+#include <stdio.h>
+
+/**
+ * Read a wave's header, leaving the file at the start of its samples; Only
+ * uncompressed 8 or 16 bits PCM is accepted
+ * 
+ * @param pSpec Filled with the samples' rate, format and channels
+ * @param pLen Size of the samples, in bytes
+ * @return 0 on success
+ */
+int wv_readHeader(FILE *pFp, SDL_AudioSpec *pSpec, unsigned int *pLen);
+
+#endif /* __WAVE_H__ */
+
@@ -39,12 +39,14 @@ using namespace Tiled;
 using namespace Gfm_ld32;
 
 #ifdef HAS_QSAVEFILE_SUPPORT
-static void writeTilemap(QSaveFile &file, QSaveFile &headerFile, const TileLayer *tileLayer);
+static void writeTilemap(QSaveFile &file, QSaveFile &headerFile, const TileLayer *tileLayer, int index);
+static void writeLayers(QSaveFile &file, QSaveFile &headerFile, const QList<const TileLayer*> &tileLayers);
 static void writeWalls(QSaveFile &file, QSaveFile &headerFile, const ObjectGroup *objs);
 static void writeStones(QSaveFile &file, QSaveFile &headerFile, const ObjectGroup *objs);
 static void writeSpikes(QSaveFile &file, QSaveFile &headerFile, const ObjectGroup *objs);
 #else
-static void writeTilemap(QFile &file, QFile &headerFile, const TileLayer *tileLayer);
+static void writeTilemap(QFile &file, QFile &headerFile, const TileLayer *tileLayer, int index);
+static void writeLayers(QFile &file, QFile &headerFile, const QList<const TileLayer*> &tileLayers);
 static void writeWalls(QFile &file, QFile &headerFile, const ObjectGroup *objs);
 static void writeStones(QFile &file, QFile &headerFile, const ObjectGroup *objs);
 static void writeSpikes(QFile &file, QFile &headerFile, const ObjectGroup *objs);
@@ -56,7 +58,7 @@ Gfm_ld32Plugin::Gfm_ld32Plugin()
 
 bool Gfm_ld32Plugin::write(const Map *map, const QString &fileName)
 {
-    int foundTileLayer;
+    QList<const TileLayer*> tileLayers;
     QString headerName = QString(fileName);
     headerName.remove(headerName.length()-1, 1);
     headerName.append("h");
@@ -89,8 +91,6 @@ bool Gfm_ld32Plugin::write(const Map *map, const QString &fileName)
     file.write("#include \"global.h\"\n");
     file.write("#include \"sprite.h\"\n\n");
     
-    foundTileLayer = 0;
-    
     // Write every layer
     foreach (const Layer *layer, map->layers()) {
         if (!layer->isVisible())
@@ -100,16 +100,18 @@ bool Gfm_ld32Plugin::write(const Map *map, const QString &fileName)
         if (layer->layerType() == Layer::TileLayerType) {
             const TileLayer *tileLayer;
             
-            if (foundTileLayer == 1) {
-                mError = tr("Found more than one tilemap!");
+            tileLayer = static_cast<const TileLayer*>(layer);
+            
+            // Every layer must be indexed the same way
+            if (!tileLayers.isEmpty() &&
+                    (tileLayer->width() != tileLayers.at(0)->width() ||
+                    tileLayer->height() != tileLayers.at(0)->height())) {
+                mError = tr("Every tilemap must have the same dimensions!");
                 return false;
             }
             
-            foundTileLayer = 1;
-            
-            tileLayer = static_cast<const TileLayer*>(layer);
-            
-            writeTilemap(file, headerFile, tileLayer);
+            writeTilemap(file, headerFile, tileLayer, tileLayers.size());
+            tileLayers.append(tileLayer);
         }
         else if (layer->layerType() == Layer::ObjectGroupType) {
             const ObjectGroup *objectGroup;
@@ -132,6 +134,10 @@ bool Gfm_ld32Plugin::write(const Map *map, const QString &fileName)
         }
     }
 
+    // Write the list of layers (only after every tilemap was declared)
+    if (!tileLayers.isEmpty())
+        writeLayers(file, headerFile, tileLayers);
+
     if (file.error() != QFile::NoError) {
         mError = file.errorString();
         return false;
@@ -175,14 +181,39 @@ Q_EXPORT_PLUGIN2(Gfm, Gfm_ld32Plugin)
     QByteArray::number((int)(var))
 
 #ifdef HAS_QSAVEFILE_SUPPORT
-static void writeTilemap(QSaveFile &file, QSaveFile &headerFile, const TileLayer *tileLayer) {
+static void writeTilemap(QSaveFile &file, QSaveFile &headerFile, const TileLayer *tileLayer, int index) {
 #else
-static void writeTilemap(QFile &file, QFile &headerFile, const TileLayer *tileLayer) {
+static void writeTilemap(QFile &file, QFile &headerFile, const TileLayer *tileLayer, int index) {
 #endif
     QStringList list = file.fileName().split("/");
     QString name = list.at(list.size()-1);
     name.remove(name.length() -2, 2);
     
+    // Every layer after the first is only referenced through the layer list
+    if (index > 0) {
+        file.write("/** Generated tilemap */\n");
+        file.write("static char ");
+        file.write(name.toLatin1());
+        file.write("_tilemap");
+        file.write(getInt(index));
+        file.write("[] = \n");
+        file.write("{\n");
+        for (int y = 0; y < tileLayer->height(); y++) {
+            file.write("  ");
+            for (int x = 0; x < tileLayer->width(); x++) {
+                const Cell &cell = tileLayer->cellAt(x, y);
+                const Tile *tile = cell.tile;
+                const int id = tile ? tile->id() : -1;
+                file.write(QByteArray::number(id));
+                file.write(",", 1);
+            }
+            
+            file.write("\n", 1);
+        }
+        file.write("};\n\n");
+        return;
+    }
+    
     // Create the tilemap's header
     headerFile.write("/** Generated tilemap */\nextern char ");
     headerFile.write(name.toLatin1());
@@ -230,6 +261,84 @@ static void writeTilemap(QFile &file, QFile &headerFile, const TileLayer *tileLa
     file.write(";\n\n");
 }
 
+#ifdef HAS_QSAVEFILE_SUPPORT
+static void writeLayers(QSaveFile &file, QSaveFile &headerFile, const QList<const TileLayer*> &tileLayers) {
+#else
+static void writeLayers(QFile &file, QFile &headerFile, const QList<const TileLayer*> &tileLayers) {
+#endif
+    int i;
+    
+    QStringList list = file.fileName().split("/");
+    QString name = list.at(list.size()-1);
+    name.remove(name.length() -2, 2);
+    
+    headerFile.write("/** Generated tilemap's layers, from the back to the front */\nextern char *");
+    headerFile.write(name.toLatin1());
+    headerFile.write("_layers[];\n");
+    headerFile.write("/** Generated tilemap's layer count */\nextern int ");
+    headerFile.write(name.toLatin1());
+    headerFile.write("_layersLen;\n");
+    headerFile.write("/** How fast each layer scrolls relative to the camera, in percents */\nextern int ");
+    headerFile.write(name.toLatin1());
+    headerFile.write("_layerParallax[];\n");
+    headerFile.write("/** Whether each layer is rendered in front of the sprites */\nextern int ");
+    headerFile.write(name.toLatin1());
+    headerFile.write("_layerIsFg[];\n");
+    
+    file.write("\n/** Generated tilemap's layers, from the back to the front */\n");
+    file.write("char *");
+    file.write(name.toLatin1());
+    file.write("_layers[] = {");
+    for (i = 0; i < tileLayers.size(); i++) {
+        file.write(name.toLatin1());
+        file.write("_tilemap");
+        if (i > 0)
+            file.write(getInt(i));
+        file.write(",", 1);
+    }
+    file.write("};\n");
+    
+    file.write("/** Generated tilemap's layer count */\n");
+    file.write("int ");
+    file.write(name.toLatin1());
+    file.write("_layersLen = ");
+    file.write(getInt(tileLayers.size()));
+    file.write(";\n");
+    
+    // The 'parallax' property sets the scroll speed (defaults to 100%)
+    file.write("/** How fast each layer scrolls relative to the camera, in percents */\n");
+    file.write("int ");
+    file.write(name.toLatin1());
+    file.write("_layerParallax[] = {");
+    for (i = 0; i < tileLayers.size(); i++) {
+        bool ok;
+        int parallax;
+        
+        parallax = tileLayers.at(i)->property("parallax").toInt(&ok);
+        if (!ok)
+            parallax = 100;
+        file.write(getInt(parallax));
+        file.write(",", 1);
+    }
+    file.write("};\n");
+    
+    // Layers whose 'foreground' property is true are rendered over the sprites
+    file.write("/** Whether each layer is rendered in front of the sprites */\n");
+    file.write("int ");
+    file.write(name.toLatin1());
+    file.write("_layerIsFg[] = {");
+    for (i = 0; i < tileLayers.size(); i++) {
+        QString isFg;
+        
+        isFg = tileLayers.at(i)->property("foreground").trimmed().toLower();
+        if (isFg == "true" || isFg == "1" || isFg == "yes")
+            file.write("1,", 2);
+        else
+            file.write("0,", 2);
+    }
+    file.write("};\n");
+}
+
 #ifdef HAS_QSAVEFILE_SUPPORT
 static void writeWalls(QSaveFile &file, QSaveFile &headerFile, const ObjectGroup *objs) {
 #else